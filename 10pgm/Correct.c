@@ -1,20 +1,30 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define ALPHABET_SIZE 26    /* A..Z */
-#define MAX_PROD 50
-#define MAX_LEN  100
+#define MAX_PROD 50         /* initial size of the production table, it grows as needed */
+#define MAX_LEN  128        /* fits a production, or a set of every printable character */
 #define EPSILON  '#'
 #define ENDMARK  '$'
 
 /* Productions stored as strings "A=rhs" */
-static char productions[MAX_PROD][MAX_LEN];
+static char (*productions)[MAX_LEN] = NULL;
 static int  num_productions = 0;
+static int  max_productions = 0;
 
-/* FIRST and FOLLOW sets indexed by letter: index = ch - 'A' */
-static char firstsets[ALPHABET_SIZE][MAX_LEN];
-static char followsets[ALPHABET_SIZE][MAX_LEN];
+/* FIRST and FOLLOW sets indexed by letter: index = ch - 'A'.
+   They point into a mapped cache file when the sets were loaded from one. */
+static char first_storage[ALPHABET_SIZE][MAX_LEN];
+static char follow_storage[ALPHABET_SIZE][MAX_LEN];
+static char (*firstsets)[MAX_LEN] = first_storage;
+static char (*followsets)[MAX_LEN] = follow_storage;
 
 /* set of nonterminals encountered (string of unique uppercase letters) */
 static char nonterminals[MAX_LEN];
@@ -83,12 +93,51 @@ static void print_set(const char *label, const char *set)
 }
 
 /* -------------------- Input -------------------- */
+
+/* Validate a production and append it, doubling the table when full */
+static void add_production(const char *prod, int line)
+{
+    if (strlen(prod) < 3 || prod[1] != '=') 
+    {
+        fprintf(stderr, "Invalid production format on line %d: %s\n", line, prod);
+        exit(1);
+    }
+    char lhs = prod[0];
+    if (!is_nonterminal(lhs)) 
+    {
+        fprintf(stderr, "LHS must be an uppercase nonterminal (A-Z): %c\n", lhs);
+        exit(1);
+    }
+    if (num_productions == max_productions)
+    {
+        max_productions = max_productions ? 2 * max_productions : MAX_PROD;
+        productions = realloc(productions, max_productions * sizeof(*productions));
+        if (!productions)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    snprintf(productions[num_productions++], MAX_LEN, "%s", prod);
+
+    /* collect nonterminals */
+    if (!strchr(nonterminals, lhs)) 
+    {
+        size_t l = strlen(nonterminals);
+        nonterminals[l] = lhs;
+        nonterminals[l+1] = '\0';
+    }
+}
+
 static void read_productions(void)
 {
+    char line[MAX_LEN];
+    int count;
+
     printf("Note: Grammar should not have left recursion (program assumes acyclic derivation)\n");
     printf("Enter number of productions: ");
 
-    if (scanf("%d", &num_productions) != 1 || num_productions <= 0) 
+    if (scanf("%d", &count) != 1 || count <= 0) 
     {
         fprintf(stderr, "Invalid number of productions\n");
         exit(1);
@@ -97,34 +146,55 @@ static void read_productions(void)
 
     printf("Enter productions in form A=BC or A=aB or A=# for epsilon (no spaces preferred)\n");
 
-    for (int i = 0; i < num_productions; ++i) {
-        if (!fgets(productions[i], sizeof(productions[i]), stdin)) 
+    for (int i = 0; i < count; ++i) {
+        if (!fgets(line, sizeof(line), stdin)) 
         {
             fprintf(stderr, "Unexpected input error\n");
             exit(1);
         }
-
-        /* trim newline */
-        productions[i][strcspn(productions[i], "\r\n")] = '\0';
-        
-        if (strlen(productions[i]) < 3 || productions[i][1] != '=') 
+        if (!strchr(line, '\n') && !feof(stdin)) /* the rest of the line didn't fit */
         {
-            fprintf(stderr, "Invalid production format on line %d: %s\n", i+1, productions[i]);
+            fprintf(stderr, "Production %d too long, at most %d characters\n", i+1, MAX_LEN-2);
             exit(1);
         }
-        char lhs = productions[i][0];
-        if (!is_nonterminal(lhs)) 
+
+        /* trim newline */
+        line[strcspn(line, "\r\n")] = '\0';
+        add_production(line, i+1);
+    }
+    start_symbol = productions[0][0];
+}
+
+/* Non-interactive input: one production per line, blank lines ignored */
+static void read_productions_file(const char *name)
+{
+    char line[MAX_LEN];
+    int lineno = 0;
+    FILE *fp = fopen(name, "r");
+
+    if (!fp)
+    {
+        fprintf(stderr, "Cannot open %s\n", name);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        ++lineno;
+        if (!strchr(line, '\n') && !feof(fp)) /* the rest of the line didn't fit */
         {
-            fprintf(stderr, "LHS must be an uppercase nonterminal (A-Z): %c\n", lhs);
+            fprintf(stderr, "Line %d of %s too long, at most %d characters\n", lineno, name, MAX_LEN-2);
             exit(1);
         }
-        /* collect nonterminals */
-        if (!strchr(nonterminals, lhs)) 
-        {
-            size_t l = strlen(nonterminals);
-            nonterminals[l] = lhs;
-            nonterminals[l+1] = '\0';
-        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0')
+            add_production(line, lineno);
+    }
+    fclose(fp);
+
+    if (num_productions == 0)
+    {
+        fprintf(stderr, "No productions in %s\n", name);
+        exit(1);
     }
     start_symbol = productions[0][0];
 }
@@ -277,25 +347,133 @@ static void compute_follow_sets(void)
     } while (changed);
 }
 
+/* -------------------- Cache -------------------- */
+
+/* The computed sets can be kept in a binary cache file: a header holding a hash
+   of the normalised grammar, followed by the FIRST and FOLLOW tables at offsets
+   from the start of the file. When the hash matches, the file is mapped and the
+   sets are used from the mapping without running the fixpoint. */
+#define CACHE_MAGIC "FFSETS"
+#define CACHE_VERSION 1
+#define BYTE_ORDER_MARK 0x01020304u
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t version, byte_order;
+    uint64_t grammar_hash;
+    uint32_t alphabet_size, set_len;
+    uint64_t first_offset, follow_offset;
+} CacheHeader;
+
+/* FNV-1a over the productions with blanks removed */
+static uint64_t hash_grammar(void)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (int p = 0; p < num_productions; ++p)
+    {
+        for (const char *c = productions[p]; *c; ++c)
+            if (!isspace((unsigned char)*c))
+                h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+        h = (h ^ '\n') * 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Map the cache and use its sets; returns 0 if it is missing or for another grammar */
+static int load_cache(const char *path, uint64_t hash)
+{
+    struct stat st;
+    size_t table = sizeof(first_storage);
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CacheHeader))
+    {
+        close(fd);
+        return 0;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const CacheHeader *hdr = (const CacheHeader *)map;
+    if (memcmp(hdr->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || hdr->version != CACHE_VERSION ||
+        hdr->byte_order != BYTE_ORDER_MARK || hdr->grammar_hash != hash ||
+        hdr->alphabet_size != ALPHABET_SIZE || hdr->set_len != MAX_LEN ||
+        (uint64_t)st.st_size < table ||     /* or the offsets below would wrap */
+        hdr->first_offset > (uint64_t)st.st_size - table || hdr->follow_offset > (uint64_t)st.st_size - table)
+    {
+        munmap(map, st.st_size);
+        return 0;
+    }
+    firstsets = (char (*)[MAX_LEN])(map + hdr->first_offset);
+    followsets = (char (*)[MAX_LEN])(map + hdr->follow_offset);
+    return 1;
+}
+
+/* Write header and tables to a temporary file, then rename it over the cache */
+static void save_cache(const char *path, uint64_t hash)
+{
+    CacheHeader hdr = { CACHE_MAGIC, CACHE_VERSION, BYTE_ORDER_MARK, hash, ALPHABET_SIZE, MAX_LEN,
+                        sizeof(CacheHeader), sizeof(CacheHeader) + sizeof(first_storage) };
+    char tmp[4096];
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "Cannot write %s\n", tmp);
+        return;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(firstsets, sizeof(first_storage), 1, fp);
+    fwrite(followsets, sizeof(follow_storage), 1, fp);
+    if (fclose(fp) != 0 || rename(tmp, path) != 0)
+        fprintf(stderr, "Cannot write %s\n", path);
+}
+
 /* -------------------- MAIN -------------------- */
-int main(void)
+/* Usage: ./a.out [-c cache] [grammar file]; without a file the grammar is read interactively.
+   With -c the sets are taken from the cache file when it was built for the same
+   grammar, otherwise they are computed and saved there. */
+int main(int argc, char *argv[])
 {
-    read_productions();
+    const char *cache_path = NULL;
+    int arg = 1;
 
-    /* compute FIRST and FOLLOW iteratively (fixpoint) */
-    compute_first_sets();
-    compute_follow_sets();
+    if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0)
+    {
+        cache_path = argv[arg + 1];
+        arg += 2;
+    }
+    if (arg < argc)
+        read_productions_file(argv[arg]);
+    else
+        read_productions();
+
+    uint64_t hash = hash_grammar();
+    if (!cache_path || !load_cache(cache_path, hash))
+    {
+        /* compute FIRST and FOLLOW iteratively (fixpoint) */
+        compute_first_sets();
+        compute_follow_sets();
+        if (cache_path)
+            save_cache(cache_path, hash);
+    }
 
     /* print FIRST sets only for nonterminals encountered */
     printf("\nFIRST sets:\n");
     for (size_t i = 0; nonterminals[i] != '\0'; ++i) {
-        char label[8]; sprintf(label, "First(%c):", nonterminals[i]);
+        char label[16]; sprintf(label, "First(%c):", nonterminals[i]);
         print_set(label, firstsets[nonterminals[i] - 'A']);
     }
 
     printf("\nFOLLOW sets:\n");
     for (size_t i = 0; nonterminals[i] != '\0'; ++i) {
-        char label[9]; sprintf(label, "Follow(%c):", nonterminals[i]);
+        char label[16]; sprintf(label, "Follow(%c):", nonterminals[i]);
         /* follow sets should not contain EPSILON */
         char temp[MAX_LEN];
         strcpy(temp, followsets[nonterminals[i] - 'A']);
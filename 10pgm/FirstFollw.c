@@ -1,13 +1,32 @@
 #include<stdio.h>
 #include<string.h>
+#include<stdlib.h>
 #include<ctype.h>
 #define SIZE 26
-#define LENGTH 20
-char productions[SIZE][LENGTH]={'\0'};
+#define LENGTH 128 //Longest production, also enough for a set of all printable characters
+char (*productions)[LENGTH]=NULL; //Grows as productions are read
 char firstsets[SIZE][LENGTH]={'\0'};
-char NonTerminals[SIZE]={'\0'};
+char followsets[SIZE][LENGTH]={'\0'};
+char NonTerminals[SIZE+1]={'\0'};
 char StartSymbol = '\0';
-int num_productions=0;
+int num_productions=0,max_productions=0;
+//States of a memoised set computation
+#define UNVISITED 0
+#define IN_PROGRESS 1
+#define DONE 2
+//Bookkeeping for computing first or follow sets once per non terminal.
+//Non terminals that depend on each other (left recursion, mutual follow sets)
+//are found as strongly connected components with Tarjan's algorithm and are
+//iterated together until none of their sets changes.
+struct memo
+{
+    int state[SIZE];
+    int order[SIZE],low[SIZE]; //visit number and lowest visit number reachable
+    int count;
+    char stack[SIZE]; //non terminals visited but not yet DONE
+    int top;
+};
+struct memo first_memo,follow_memo;
 //Adds a character to a set represented as a string
 void set_add(char *set,char elem)
 {
@@ -63,19 +82,112 @@ int get_index(char NT)
 {
     return NT-'A';
 }
+//Marks a non terminal as being computed
+void memo_enter(struct memo *m,int idx)
+{
+    m->state[idx]=IN_PROGRESS;
+    m->order[idx]=m->low[idx]=++m->count;
+    m->stack[m->top++]='A'+idx;
+}
+//Records that the set of idx depends on the set of dep, which has been visited
+void memo_edge(struct memo *m,int idx,int dep)
+{
+    if(m->state[dep]==IN_PROGRESS && m->low[dep]<m->low[idx])
+        m->low[idx]=m->low[dep]; //dep is on a cycle through idx
+}
+//Finishes a non terminal. If it is the root of a cycle, update is applied to all
+//members of the cycle until nothing changes and they are all marked DONE
+void memo_leave(struct memo *m,int idx,int (*update)(char))
+{
+    char members[SIZE+1];
+    int n=0,changed;
+    if(m->low[idx]!=m->order[idx]) //the root of the cycle will solve it
+        return;
+    do
+    {
+        members[n]=m->stack[--m->top];
+    }while(members[n++]!='A'+idx);
+    do
+    {
+        changed=0;
+        for(int i=0;i<n;i++)
+            changed|=update(members[i]);
+    }while(changed);
+    for(int i=0;i<n;i++)
+        m->state[get_index(members[i])]=DONE;
+}
+//Appends a production to the table, doubling the table when it is full
+void add_production(char *prod)
+{
+    if(num_productions==max_productions)
+    {
+        max_productions = max_productions ? 2*max_productions : SIZE;
+        productions = realloc(productions,max_productions*sizeof(*productions));
+        if(!productions)
+        {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+    snprintf(productions[num_productions++],LENGTH,"%s",prod);
+    set_add(NonTerminals,prod[0]);//Add LHS to set of NT
+}
 //Get all productions from user
 void read_productions()
 {
-    printf("Make sure to eliminate left recursion from grammar, else program will crash\n");
+    char line[LENGTH];
+    int count=0;
+    printf("Left recursive grammars are accepted\n");
     printf("Enter the number of productions.(LHS of first production is taken as start symbol)\n");
-    scanf("%d",&num_productions);
+    if(scanf("%d",&count)!=1 || count<=0)
+    {
+        printf("Invalid number of productions\n");
+        exit(1);
+    }
     printf("Enter the productions as A=Bc,A=# (Use # for epsilon and = for arrow)\n");
     getchar(); //Remove new line from stdin
-    for(int i=0;i<num_productions;i++)
+    for(int i=0;i<count;i++)
+    {
+        if(scanf("%127[^\n]",line)!=1)
+        {
+            printf("Expected a production\n");
+            exit(1);
+        }
+        if(getchar()!='\n' && !feof(stdin)) //The rest of the line didn't fit
+        {
+            printf("Production too long, at most %d characters\n",LENGTH-1);
+            exit(1);
+        }
+        add_production(line);
+    }
+    StartSymbol = productions[0][0];
+}
+//Reads one production per line from a file without prompting, used for batch runs
+void read_productions_file(char *name)
+{
+    char line[LENGTH];
+    FILE *fp=fopen(name,"r");
+    if(!fp)
+    {
+        printf("File doesn't exist\n");
+        exit(1);
+    }
+    while(fgets(line,sizeof(line),fp))
+    {
+        if(!strchr(line,'\n') && !feof(fp)) //The rest of the line didn't fit
+        {
+            printf("Production too long in %s, at most %d characters\n",name,LENGTH-2);
+            exit(1);
+        }
+        line[strcspn(line,"\r\n")]='\0';
+        if(line[0]!='\0')
+            add_production(line);
+    }
+    fclose(fp);
+    if(num_productions==0)
     {
-        scanf("%[^\n]",productions[i]);
-        getchar(); //Remove new line from stdin
-        set_add(NonTerminals,productions[i][0]);//Add LHS to set of NT
+        printf("No productions in %s\n",name);
+        exit(1);
     }
     StartSymbol = productions[0][0];
 }
@@ -121,52 +233,74 @@ void read_productions()
 // }
 
 // ...existing code...
-void calc_first(char symbol,char *set)
+//Adds FIRST of the symbol string rhs to set, plus # if all of rhs can derive epsilon.
+//Only the stored first sets are read, so the non terminals of rhs must already be
+//computed (or be part of the cycle currently being solved)
+void rhs_first(char *rhs,char *set)
 {
-    if(symbol=='\0')
-        return;
-    if(!isupper(symbol)) // terminal or '#'
+    for(int j=0;rhs[j]!='\0';j++)
     {
-        set_add(set,symbol);
-        return;
+        if(rhs[j]=='#') //explicit epsilon, look at the next symbol
+            continue;
+        if(!isupper(rhs[j])) //a terminal ends the scan
+        {
+            set_add(set,rhs[j]);
+            return;
+        }
+        char *first=firstsets[get_index(rhs[j])];
+        for(int k=0;first[k]!='\0';k++)
+            if(first[k]!='#')
+                set_add(set,first[k]);
+        if(!is_in_set(first,'#')) //non terminal can't vanish, so the scan stops here
+            return;
     }
-
-    /* For each production A = alpha where A == symbol,
-       compute FIRST(alpha) and union into set.
-       Only add '#' for A if some production's entire RHS is nullable. */
+    set_add(set,'#'); //every symbol of rhs can derive epsilon
+}
+//Recomputes the first set of NT from its productions, returns 1 if it grew
+int first_update(char NT)
+{
+    char *set=firstsets[get_index(NT)];
+    size_t before=strlen(set);
+    for(int i=0;i<num_productions;i++)
+        if(productions[i][0]==NT)
+            rhs_first(productions[i]+2,set);
+    return strlen(set)!=before;
+}
+//Visits NT and every non terminal on its right hand sides, so each first set is
+//computed exactly once. Left recursion just forms a cycle and is solved by memo_leave
+void first_visit(char NT)
+{
+    int idx=get_index(NT);
+    memo_enter(&first_memo,idx);
     for(int i=0;i<num_productions;i++)
     {
-        if(productions[i][0] != symbol) continue;
-
-        int j = 2;
-        int all_nullable = 1;           // assume RHS nullable until proven otherwise
-
-        while(productions[i][j] != '\0')
+        if(productions[i][0]!=NT)
+            continue;
+        for(int j=2;productions[i][j]!='\0';j++)
         {
-            char temp_first[SIZE] = {'\0'};
-            calc_first(productions[i][j], temp_first);
-
-            // add FIRST(productions[i][j]) \ {#} to result
-            for(int k=0; temp_first[k] != '\0'; k++)
-            {
-                if(temp_first[k] != '#')
-                    set_add(set, temp_first[k]);
-            }
-
-            // if this symbol can produce epsilon, continue to next symbol
-            if(is_in_set(temp_first,'#'))
-            {
-                j++;
+            char dep=productions[i][j];
+            if(!isupper(dep))
                 continue;
-            }
-            // otherwise RHS is not entirely nullable
-            all_nullable = 0;
-            break;
+            if(first_memo.state[get_index(dep)]==UNVISITED)
+                first_visit(dep);
+            memo_edge(&first_memo,idx,get_index(dep));
         }
-
-        if(all_nullable)
-            set_add(set,'#');
     }
+    memo_leave(&first_memo,idx,first_update);
+}
+//Adds the first set of symbol to set, computing it on the first request only
+void calc_first(char symbol,char *set)
+{
+    if(symbol=='\0')
+        return;
+    if(!isupper(symbol)) // terminal or '#'
+    {
+        set_add(set,symbol);
+        return;
+    }
+    if(first_memo.state[get_index(symbol)]==UNVISITED)
+        first_visit(symbol);
+    set_union(set,firstsets[get_index(symbol)]);
 }
 // ...existing code...
 // //Function to find the follow sets
@@ -221,96 +355,88 @@ void calc_first(char symbol,char *set)
 // }
 
 // ...existing code...
-void calc_follow(char symbol,char *set)
+//Recomputes the follow set of NT from every occurrence of NT in a right hand side,
+//returns 1 if it grew
+int follow_update(char NT)
 {
-    if(symbol=='\0')
-        return;
-    if(!isupper(symbol))
-    {
-        set_add(set,symbol);
-        return;
-    }
-    if(symbol==StartSymbol)
+    char *set=followsets[get_index(NT)];
+    size_t before=strlen(set);
+    if(NT==StartSymbol)
         set_add(set,'$');
-
     for(int i=0;i<num_productions;i++)
     {
-        for(int j=2; productions[i][j]!='\0'; j++)
+        for(int j=2;productions[i][j]!='\0';j++)
         {
-            if(productions[i][j] != symbol)
-                continue;
-
-            /* If symbol is last in RHS -> add FOLLOW(LHS) */
-            if(productions[i][j+1] == '\0')
-            {
-                if(productions[i][0] != symbol) /* avoid immediate self-loop */
-                    calc_follow(productions[i][0], set);
+            if(productions[i][j]!=NT)
                 continue;
-            }
-
-            /* Otherwise examine the suffix after symbol */
-            int k = j+1;
-            int need_follow_lhs = 1; /* true until we find a non-epsilon FIRST */
-            while(productions[i][k] != '\0')
+            char temp[LENGTH]={'\0'};
+            rhs_first(productions[i]+j+1,temp); //FIRST of the suffix after NT
+            if(is_in_set(temp,'#')) //suffix can vanish, so FOLLOW(LHS) follows NT too
             {
-                char nxt = productions[i][k];
-
-                if(nxt == '#') /* explicit epsilon in RHS: keep scanning */
-                {
-                    k++;
-                    continue;
-                }
-
-                if(!isupper(nxt)) /* terminal: add it to FOLLOW(symbol) */
-                {
-                    set_add(set, nxt);
-                    need_follow_lhs = 0;
-                    break;
-                }
-
-                /* nxt is non-terminal: add FIRST(nxt) \ {#} */
-                for(int t = 0; firstsets[get_index(nxt)][t] != '\0'; t++)
-                {
-                    char f = firstsets[get_index(nxt)][t];
-                    if(f != '#') set_add(set, f);
-                }
-
-                /* if FIRST(nxt) contains epsilon, continue to next symbol */
-                if(is_in_set(firstsets[get_index(nxt)], '#'))
-                {
-                    k++;
-                    continue;
-                }
-                else
-                {
-                    need_follow_lhs = 0;
-                    break;
-                }
-            }
-
-            /* if all symbols to the right can produce epsilon, add FOLLOW(LHS) */
-            if(need_follow_lhs)
-            {
-                if(productions[i][0] != symbol)
-                    calc_follow(productions[i][0], set);
+                set_remove(temp,'#');
+                set_union(set,followsets[get_index(productions[i][0])]);
             }
+            set_union(set,temp);
         }
     }
+    return strlen(set)!=before;
+}
+//Visits NT and every LHS whose follow set flows into FOLLOW(NT). Mutually
+//dependent follow sets form a cycle and are solved together by memo_leave
+void follow_visit(char NT)
+{
+    int idx=get_index(NT);
+    memo_enter(&follow_memo,idx);
+    for(int i=0;i<num_productions;i++)
+    {
+        char lhs=productions[i][0];
+        for(int j=2;productions[i][j]!='\0';j++)
+        {
+            if(productions[i][j]!=NT)
+                continue;
+            if(first_memo.state[get_index(lhs)]==UNVISITED) //first sets of this RHS are needed
+                first_visit(lhs);
+            char temp[LENGTH]={'\0'};
+            rhs_first(productions[i]+j+1,temp);
+            if(!is_in_set(temp,'#'))
+                continue;
+            if(follow_memo.state[get_index(lhs)]==UNVISITED)
+                follow_visit(lhs);
+            memo_edge(&follow_memo,idx,get_index(lhs));
+        }
+    }
+    memo_leave(&follow_memo,idx,follow_update);
+}
+//Adds the follow set of symbol to set, computing it on the first request only
+void calc_follow(char symbol,char *set)
+{
+    if(symbol=='\0')
+        return;
+    if(!isupper(symbol))
+    {
+        set_add(set,symbol);
+        return;
+    }
+    if(follow_memo.state[get_index(symbol)]==UNVISITED)
+        follow_visit(symbol);
+    set_union(set,followsets[get_index(symbol)]);
 }
 // ...existing code...
 
-int main()
+//Usage: ./a.out [grammar file], productions are read interactively without a file
+int main(int argc,char *argv[])
 {
     char temp[LENGTH];
-    read_productions();
+    if(argc>1)
+        read_productions_file(argv[1]);
+    else
+        read_productions();
     //Compute & print the first sets of all non terminals
     for(int i=0;NonTerminals[i]!='\0';i++)
     {
         strcpy(temp,"");
         calc_first(NonTerminals[i],temp);
         printf("First(%c):",NonTerminals[i]);
-        //Store first sets to be used when computing follow.
-        strcpy(firstsets[get_index(NonTerminals[i])],temp);
         printset(temp);
     }
     //Compute & print the follow sets of all non terminals
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*
+ * Differential test and timing harness for the FIRST/FOLLOW programs.
+ *
+ * Random grammars are generated in the A=rhs format, written to a file and
+ * passed as argv[1] to every program (their non-interactive entry point).
+ * The printed FIRST and FOLLOW sets are parsed back, compared against the
+ * first program given, and each run's wall time and peak memory are reported
+ * as the grammar grows.
+ *
+ * Build:  gcc -O2 -o harness Harness.c
+ * Usage:  ./harness [options] ./correct ./firstfollw ./simple
+ *   -p list   comma separated production counts to sweep (default 100,1000,10000,100000)
+ *   -n num    number of nonterminals, 1..26 (default 26)
+ *   -t num    number of terminals, 1..36 (default 10)
+ *   -l num    maximum RHS length, 1..100 (default 6)
+ *   -e frac   nullable density: fraction of nonterminals with an A=# production (default 0.3)
+ *   -r depth  recursion depth: a RHS of the i-th nonterminal may refer back to
+ *             nonterminals i-depth..i, 0 gives an acyclic grammar (default 2)
+ *   -s seed   random seed (default 1)
+ *   -g size   only print the grammar generated for that size of the -p list
+ *             and exit, to reproduce a mismatch reported for it
+ */
+
+#define ALPHABET_SIZE 26
+#define MAX_RHS 100
+#define MAX_PROGS 8
+
+static const char terminal_chars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+/* Generator parameters */
+static int    num_nonterminals = 26;
+static int    num_terminals    = 10;
+static int    max_rhs          = 6;
+static double nullable_density = 0.3;
+static int    recursion_depth  = 2;
+static uint64_t rng_state      = 1;
+
+/* Sets parsed from one program's output, one bit per character */
+typedef struct
+{
+    uint64_t first[ALPHABET_SIZE][2];
+    uint64_t follow[ALPHABET_SIZE][2];
+    int      seen[ALPHABET_SIZE];       /* bit 0: FIRST printed, bit 1: FOLLOW printed */
+} Sets;
+
+/* -------------------- Grammar generation -------------------- */
+
+/* xorshift64*, so a seed gives the same grammar on every platform */
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static int random_below(int n)
+{
+    return (int)(next_random() % (uint64_t)n);
+}
+
+static double random_unit(void)
+{
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Pick a nonterminal that the i-th nonterminal may refer to */
+static char pick_nonterminal(int i)
+{
+    int lo = i - recursion_depth;
+    if (lo < 0) lo = 0;
+    return 'A' + lo + random_below(num_nonterminals - lo);
+}
+
+/* Write a grammar with num_prods productions. Every nonterminal gets at least one
+   production, the start symbol A comes first. */
+static void generate_grammar(FILE *out, int num_prods)
+{
+    char rhs[MAX_RHS + 1];
+    int  written = 0;
+
+    for (int p = 0; p < num_prods || written < num_nonterminals; ++p, ++written)
+    {
+        int lhs = written < num_nonterminals ? written : random_below(num_nonterminals);
+
+        /* nullable nonterminals get their epsilon production up front */
+        if (written < num_nonterminals && random_unit() < nullable_density)
+        {
+            fprintf(out, "%c=#\n", 'A' + lhs);
+            ++p;
+        }
+
+        int len = 1 + random_below(max_rhs);
+        for (int k = 0; k < len; ++k)
+        {
+            if (random_below(2))
+                rhs[k] = pick_nonterminal(lhs);
+            else
+                rhs[k] = terminal_chars[random_below(num_terminals)];
+        }
+        rhs[len] = '\0';
+        fprintf(out, "%c=%s\n", 'A' + lhs, rhs);
+    }
+}
+
+/* -------------------- Running a program -------------------- */
+
+static double elapsed_ms(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/* Run prog with the grammar file as its only argument, stdout to out_path.
+   Returns the exit status, or -1 if the program could not be run. */
+static int run_program(const char *prog, const char *grammar_path, const char *out_path,
+                       double *ms, long *maxrss_kb)
+{
+    struct timespec start, end;
+    struct rusage usage;
+    int status;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0)
+            _exit(127);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+        execl(prog, prog, grammar_path, (char *)NULL);
+        _exit(127);
+    }
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *ms = elapsed_ms(&start, &end);
+    *maxrss_kb = usage.ru_maxrss;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/* -------------------- Parsing the printed sets -------------------- */
+
+static void set_bit(uint64_t *set, unsigned char c)
+{
+    set[c >> 6 & 1] |= 1ULL << (c & 63);
+}
+
+/* Accepts the output formats of all three programs, e.g. "First(E):{a,b}",
+   "FIRST(E) = {a,b}" and "Follow(E): {$,a}". Epsilon is ignored in FOLLOW. */
+static void parse_output(const char *path, Sets *sets)
+{
+    char line[512];
+    FILE *fp = fopen(path, "r");
+
+    memset(sets, 0, sizeof(*sets));
+    if (!fp)
+        return;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        int is_follow;
+        if (strncasecmp(line, "first(", 6) == 0)
+            is_follow = 0;
+        else if (strncasecmp(line, "follow(", 7) == 0)
+            is_follow = 1;
+        else
+            continue;
+
+        char *p = strchr(line, '(') + 1;
+        if (*p < 'A' || *p > 'Z')
+            continue;
+        int nt = *p - 'A';
+        char *open = strchr(p, '{');
+        char *close = open ? strrchr(open, '}') : NULL;
+        if (!close)
+            continue;
+
+        uint64_t *set = is_follow ? sets->follow[nt] : sets->first[nt];
+        for (char *c = open + 1; c < close; ++c)
+        {
+            if (*c == ',' || (is_follow && *c == '#'))
+                continue;
+            set_bit(set, (unsigned char)*c);
+        }
+        sets->seen[nt] |= is_follow ? 2 : 1;
+    }
+    fclose(fp);
+}
+
+static void print_bits(const uint64_t *set)
+{
+    putchar('{');
+    for (int c = 0; c < 128; ++c)
+        if (set[c >> 6] >> (c & 63) & 1)
+            putchar(c);
+    putchar('}');
+}
+
+/* Count the sets in got that differ from ref, reporting the first one */
+static int diff_sets(const Sets *ref, const Sets *got)
+{
+    int mismatches = 0;
+
+    for (int nt = 0; nt < ALPHABET_SIZE; ++nt)
+    {
+        for (int kind = 0; kind < 2; ++kind)
+        {
+            const uint64_t *a = kind ? ref->follow[nt] : ref->first[nt];
+            const uint64_t *b = kind ? got->follow[nt] : got->first[nt];
+            int seen_a = ref->seen[nt] >> kind & 1, seen_b = got->seen[nt] >> kind & 1;
+
+            if (seen_a == seen_b && a[0] == b[0] && a[1] == b[1])
+                continue;
+            if (mismatches++ == 0)
+            {
+                printf("    first difference %s(%c): expected ", kind ? "FOLLOW" : "FIRST", 'A' + nt);
+                print_bits(a);
+                printf(" got ");
+                print_bits(b);
+                putchar('\n');
+            }
+        }
+    }
+    return mismatches;
+}
+
+/* -------------------- MAIN -------------------- */
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-p sizes] [-n nonterminals] [-t terminals] [-l max rhs length]\n"
+                    "       [-e nullable density] [-r recursion depth] [-s seed] [-g size] program...\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *size_list = "100,1000,10000,100000";
+    int only_grammar = 0, opt;
+
+    while ((opt = getopt(argc, argv, "p:n:t:l:e:r:s:g:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': size_list = optarg; break;
+        case 'n': num_nonterminals = atoi(optarg); break;
+        case 't': num_terminals = atoi(optarg); break;
+        case 'l': max_rhs = atoi(optarg); break;
+        case 'e': nullable_density = atof(optarg); break;
+        case 'r': recursion_depth = atoi(optarg); break;
+        case 's': rng_state = strtoull(optarg, NULL, 10); break;
+        case 'g': only_grammar = atoi(optarg); break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (num_nonterminals < 1 || num_nonterminals > ALPHABET_SIZE ||
+        num_terminals < 1 || num_terminals > (int)strlen(terminal_chars) ||
+        max_rhs < 1 || max_rhs > MAX_RHS || recursion_depth < 0 || only_grammar < 0)
+        usage(argv[0]);
+    if (rng_state == 0)
+        rng_state = 1;                          /* xorshift can't leave zero */
+
+    if (only_grammar)
+    {
+        /* The random state runs on from one size to the next, so the sizes
+           before it in the list are generated too and thrown away */
+        char list[256];
+        FILE *sink = fopen("/dev/null", "w");
+        if (!sink)
+        {
+            perror("/dev/null");
+            return 1;
+        }
+        snprintf(list, sizeof(list), "%s", size_list);
+        for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ","))
+        {
+            if (atoi(tok) == only_grammar)
+            {
+                generate_grammar(stdout, only_grammar);
+                return 0;
+            }
+            generate_grammar(sink, atoi(tok));
+        }
+        fprintf(stderr, "%d is not one of the sizes given with -p\n", only_grammar);
+        return 1;
+    }
+
+    int num_progs = argc - optind;
+    if (num_progs < 1 || num_progs > MAX_PROGS)
+        usage(argv[0]);
+
+    char grammar_path[] = "/tmp/grammarXXXXXX";
+    char out_path[] = "/tmp/setsXXXXXX";
+    int gfd = mkstemp(grammar_path), ofd = mkstemp(out_path);
+    if (gfd < 0 || ofd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(gfd);                                 /* both are reopened by name */
+    close(ofd);
+
+    static Sets ref, got;
+    int failures = 0;
+    char sizes[256];
+    snprintf(sizes, sizeof(sizes), "%s", size_list);
+
+    printf("%-10s %-24s %12s %12s  %s\n", "prods", "program", "time(ms)", "maxrss(KB)", "result");
+    for (char *tok = strtok(sizes, ","); tok; tok = strtok(NULL, ","))
+    {
+        int num_prods = atoi(tok);
+        FILE *g = fopen(grammar_path, "w");
+        generate_grammar(g, num_prods);
+        fclose(g);
+
+        int have_ref = 0;   /* the reference ran for this size */
+        for (int i = 0; i < num_progs; ++i)
+        {
+            const char *prog = argv[optind + i];
+            double ms = 0;
+            long rss = 0;
+            int status = run_program(prog, grammar_path, out_path, &ms, &rss);
+            int mismatches = 0;
+
+            if (status == 0)
+            {
+                parse_output(out_path, i == 0 ? &ref : &got);
+                if (i == 0)
+                    have_ref = 1;
+                else if (have_ref)
+                    mismatches = diff_sets(&ref, &got);
+            }
+            printf("%-10d %-24s %12.2f %12ld  ", num_prods, prog, ms, rss);
+            if (status != 0)
+                printf("exit status %d\n", status);
+            else if (i == 0)
+                printf("reference\n");
+            else if (!have_ref)
+                printf("not compared, the reference failed\n");
+            else if (mismatches)
+                printf("%d sets differ, -g %d prints the grammar\n", mismatches, num_prods);
+            else
+                printf("agrees\n");
+            failures += status != 0 || mismatches != 0;
+        }
+    }
+
+    unlink(grammar_path);
+    unlink(out_path);
+    return failures != 0;
+}
@@ -1,16 +1,35 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 
 #define SIZE 26
-#define LENGTH 50
+#define LENGTH 128 // longest production; also fits a set of every printable char
 
 // -------------------- Global Variables --------------------
-char productions[SIZE][LENGTH] = { '\0' };
+char (*productions)[LENGTH]    = NULL; // grows while reading
 char firstSets[SIZE][LENGTH]   = { '\0' };
-char nonTerminals[SIZE]        = { '\0' };
+char followSets[SIZE][LENGTH]  = { '\0' };
+char nonTerminals[SIZE + 1]    = { '\0' };
 char startSymbol               = '\0';
 int  numProductions            = 0;
+int  maxProductions            = 0;
+
+// -------------------- Memoisation --------------------
+// Every FIRST/FOLLOW set is computed once. Non-terminals whose sets depend on
+// each other (left recursion, mutual FOLLOW) form strongly connected components,
+// found with Tarjan's algorithm and iterated together until nothing changes.
+enum { UNVISITED, IN_PROGRESS, DONE };
+
+typedef struct {
+    int  state[SIZE];
+    int  order[SIZE], low[SIZE]; // visit number, lowest visit number reachable
+    int  count;
+    char stack[SIZE];            // visited but not yet DONE
+    int  top;
+} Memo;
+
+Memo firstMemo, followMemo;
 
 // -------------------- Utility Functions --------------------
 int indexOf(char nt) { return nt - 'A'; }
@@ -48,19 +67,106 @@ void printSet(const char *set) {
     printf("}\n");
 }
 
+// -------------------- Memo Helpers --------------------
+void memoEnter(Memo *m, char nt) {
+    m->state[indexOf(nt)] = IN_PROGRESS;
+    m->order[indexOf(nt)] = m->low[indexOf(nt)] = ++m->count;
+    m->stack[m->top++] = nt;
+}
+
+// nt depends on dep, which has already been visited
+void memoEdge(Memo *m, char nt, char dep) {
+    if (m->state[indexOf(dep)] == IN_PROGRESS && m->low[indexOf(dep)] < m->low[indexOf(nt)])
+        m->low[indexOf(nt)] = m->low[indexOf(dep)];
+}
+
+// If nt is the root of a component, run update over its members to a fixpoint
+void memoLeave(Memo *m, char nt, int (*update)(char)) {
+    char members[SIZE + 1];
+    int n = 0, changed;
+
+    if (m->low[indexOf(nt)] != m->order[indexOf(nt)])
+        return; // the component's root solves it
+
+    do {
+        members[n] = m->stack[--m->top];
+    } while (members[n++] != nt);
+
+    do {
+        changed = 0;
+        for (int i = 0; i < n; i++)
+            changed |= update(members[i]);
+    } while (changed);
+
+    for (int i = 0; i < n; i++)
+        m->state[indexOf(members[i])] = DONE;
+}
+
 // -------------------- Grammar Input --------------------
+void addProduction(const char *prod) {
+    if (numProductions == maxProductions) { // double the table when full
+        maxProductions = maxProductions ? 2 * maxProductions : SIZE;
+        productions = realloc(productions, maxProductions * sizeof(*productions));
+        if (productions == NULL) {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+    snprintf(productions[numProductions++], LENGTH, "%s", prod);
+    addToSet(nonTerminals, prod[0]);
+}
+
 void readProductions() {
-    printf("⚠️ Ensure the grammar has no left recursion.\n");
+    char line[LENGTH];
+    int count = 0;
+
+    printf("Left recursive grammars are accepted.\n");
     printf("Enter number of productions: ");
-    scanf("%d", &numProductions);
+    if (scanf("%d", &count) != 1 || count <= 0) {
+        printf("Invalid number of productions\n");
+        exit(1);
+    }
     getchar(); // clear newline
 
     printf("Enter productions (Format: A=abc | A=# for epsilon)\n");
 
-    for (int i = 0; i < numProductions; i++) {
-        scanf("%[^\n]", productions[i]);
-        getchar(); // clear newline
-        addToSet(nonTerminals, productions[i][0]);
+    for (int i = 0; i < count; i++) {
+        if (scanf("%127[^\n]", line) != 1) {
+            printf("Expected a production\n");
+            exit(1);
+        }
+        if (getchar() != '\n' && !feof(stdin)) { // the rest of the line didn't fit
+            printf("Production too long, at most %d characters\n", LENGTH - 1);
+            exit(1);
+        }
+        addProduction(line);
+    }
+    startSymbol = productions[0][0];
+}
+
+// Batch input: one production per line, no prompts
+void readProductionsFile(const char *name) {
+    char line[LENGTH];
+    FILE *fp = fopen(name, "r");
+
+    if (fp == NULL) {
+        printf("Cannot open %s\n", name);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (strchr(line, '\n') == NULL && !feof(fp)) { // the rest of the line didn't fit
+            printf("Production too long in %s, at most %d characters\n", name, LENGTH - 2);
+            exit(1);
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0')
+            addProduction(line);
+    }
+    fclose(fp);
+
+    if (numProductions == 0) {
+        printf("No productions in %s\n", name);
+        exit(1);
     }
     startSymbol = productions[0][0];
 }
@@ -96,45 +202,74 @@ void readProductions() {
 //     }
 // }
 
-// ...existing code...
-void calcFirst(char symbol, char *result) {
-    if (!isupper(symbol)) {               // terminal or '#'
-        addToSet(result, symbol);
-        return;
+// Adds FIRST(rhs) to result, plus '#' if the whole string can derive epsilon.
+// Reads firstSets only, so the non-terminals in rhs must already be computed.
+void rhsFirst(const char *rhs, char *result) {
+    for (int pos = 0; rhs[pos] != '\0'; pos++) {
+        if (rhs[pos] == '#')
+            continue;
+        if (!isupper(rhs[pos])) { // terminal
+            addToSet(result, rhs[pos]);
+            return;
+        }
+        char *first = firstSets[indexOf(rhs[pos])];
+        for (int k = 0; first[k] != '\0'; k++)
+            if (first[k] != '#')
+                addToSet(result, first[k]);
+        if (!isInSet(first, '#'))
+            return;
     }
+    addToSet(result, '#'); // whole RHS can become epsilon
+}
 
+int firstUpdate(char symbol) {
+    char *set = firstSets[indexOf(symbol)];
+    size_t before = strlen(set);
+
+    for (int i = 0; i < numProductions; i++)
+        if (productions[i][0] == symbol)
+            rhsFirst(productions[i] + 2, set); // skip "A="
+    return strlen(set) != before;
+}
+
+void firstVisit(char symbol) {
+    memoEnter(&firstMemo, symbol);
     for (int i = 0; i < numProductions; i++) {
         if (productions[i][0] != symbol) continue;
-        int pos = 2; // skip "A="
-        int allNullable = 1;
-
-        while (productions[i][pos] != '\0') {
-            char temp[LENGTH] = { '\0' };
-            calcFirst(productions[i][pos], temp);
-
-            // add FIRST(sym) \ {#}
-            for (int k = 0; temp[k] != '\0'; k++)
-                if (temp[k] != '#')
-                    addToSet(result, temp[k]);
-
-            if (isInSet(temp, '#')) {
-                pos++; // symbol can be epsilon, continue to next symbol
-            } else {
-                allNullable = 0;
-                break;
-            }
+        for (int pos = 2; productions[i][pos] != '\0'; pos++) {
+            char dep = productions[i][pos];
+            if (!isupper(dep)) continue;
+            if (firstMemo.state[indexOf(dep)] == UNVISITED)
+                firstVisit(dep);
+            memoEdge(&firstMemo, symbol, dep);
         }
+    }
+    memoLeave(&firstMemo, symbol, firstUpdate);
+}
 
-        if (allNullable) // whole RHS can become epsilon
-            addToSet(result, '#');
+void calcFirst(char symbol, char *result) {
+    if (!isupper(symbol)) {               // terminal or '#'
+        addToSet(result, symbol);
+        return;
     }
+    if (firstMemo.state[indexOf(symbol)] == UNVISITED)
+        firstVisit(symbol);
+    unionSets(result, firstSets[indexOf(symbol)]);
 }
-// ...existing code...
 
 // -------------------- FOLLOW Set Computation --------------------
-void calcFollow(char symbol, char *result) {
-    if (!isupper(symbol))
-        return;
+// Only the symbol right after an occurrence is examined; when it is nullable
+// or absent, FOLLOW(LHS) is added instead.
+int dependsOnLhs(const char *rhs, int j, char symbol, char lhs) {
+    char next = rhs[j + 1];
+    if (next != '\0' && isupper(next))
+        return isInSet(firstSets[indexOf(next)], '#');
+    return next == '\0' && lhs != symbol;
+}
+
+int followUpdate(char symbol) {
+    char *result = followSets[indexOf(symbol)];
+    size_t before = strlen(result);
 
     if (symbol == startSymbol)
         addToSet(result, '$'); // $ for start symbol
@@ -143,39 +278,66 @@ void calcFollow(char symbol, char *result) {
         char *rhs = strchr(productions[i], '=') + 1;
 
         for (int j = 0; rhs[j] != '\0'; j++) {
-            if (rhs[j] == symbol) {
-                char next = rhs[j + 1];
-
-                // Case 1: Next symbol is terminal
-                if (next != '\0' && !isupper(next) && next != '#')
-                    addToSet(result, next);
-
-                // Case 2: Next symbol is non-terminal
-                else if (next != '\0' && isupper(next)) {
-                    unionSets(result, firstSets[indexOf(next)]);
-                    if (isInSet(firstSets[indexOf(next)], '#'))
-                        calcFollow(productions[i][0], result);
-                }
-
-                // Case 3: Symbol is at end
-                else if (next == '\0' && productions[i][0] != symbol)
-                    calcFollow(productions[i][0], result);
-            }
+            if (rhs[j] != symbol) continue;
+            char next = rhs[j + 1];
+
+            // Case 1: Next symbol is terminal
+            if (next != '\0' && !isupper(next) && next != '#')
+                addToSet(result, next);
+
+            // Case 2: Next symbol is non-terminal
+            else if (next != '\0' && isupper(next))
+                unionSets(result, firstSets[indexOf(next)]);
+
+            // Case 2 with nullable next, or Case 3: symbol is at end
+            if (dependsOnLhs(rhs, j, symbol, productions[i][0]))
+                unionSets(result, followSets[indexOf(productions[i][0])]);
+        }
+    }
+    return strlen(result) != before;
+}
+
+void followVisit(char symbol) {
+    memoEnter(&followMemo, symbol);
+    for (int i = 0; i < numProductions; i++) {
+        char lhs = productions[i][0];
+        char *rhs = strchr(productions[i], '=') + 1;
+
+        for (int j = 0; rhs[j] != '\0'; j++) {
+            if (rhs[j] != symbol) continue;
+            if (isupper(rhs[j + 1]) && firstMemo.state[indexOf(rhs[j + 1])] == UNVISITED)
+                firstVisit(rhs[j + 1]);
+            if (!dependsOnLhs(rhs, j, symbol, lhs)) continue;
+            if (followMemo.state[indexOf(lhs)] == UNVISITED)
+                followVisit(lhs);
+            memoEdge(&followMemo, symbol, lhs);
         }
     }
+    memoLeave(&followMemo, symbol, followUpdate);
+}
+
+void calcFollow(char symbol, char *result) {
+    if (!isupper(symbol))
+        return;
+    if (followMemo.state[indexOf(symbol)] == UNVISITED)
+        followVisit(symbol);
+    unionSets(result, followSets[indexOf(symbol)]);
 }
 
 // -------------------- MAIN --------------------
-int main() {
+// Usage: ./a.out [grammar file]; without a file the grammar is read interactively
+int main(int argc, char *argv[]) {
     char temp[LENGTH];
 
-    readProductions();
+    if (argc > 1)
+        readProductionsFile(argv[1]);
+    else
+        readProductions();
 
     printf("\n---- FIRST Sets ----\n");
     for (int i = 0; nonTerminals[i] != '\0'; i++) {
         strcpy(temp, "");
         calcFirst(nonTerminals[i], temp);
-        strcpy(firstSets[indexOf(nonTerminals[i])], temp);
         printf("FIRST(%c) = ", nonTerminals[i]);
         printSet(temp);
     }
@@ -0,0 +1,1438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// LR parser generator and table driven shift-reduce parser.
+//
+// Usage: ./a.out [-s] [-t] [-v] [-d] [-b] [-c cache] grammar [input]
+//   -s  build SLR(1) tables (default is LALR(1))
+//   -t  print the ACTION/GOTO tables
+//   -v  print every parser action
+//   -d  parse with the dense tables instead of the compressed ones
+//   -b  parse every input with both and compare the throughput
+//   -c  reuse the tables saved in the cache file if it was built from the
+//       same grammar, otherwise build them and save them there
+// The grammar file holds one production per line, either in the 10pgm form
+// "E=E+T" (single character symbols, # for epsilon) or with named symbols as
+// "expr -> expr + term" (an empty right side is epsilon). Symbols that appear
+// on a left side are nonterminals, the first left side is the start symbol.
+// Lines starting with // are comments.
+// Every line of the input file (stdin if omitted or "-") is parsed as one
+// sentence; tokens are characters, or blank separated names for named grammars.
+
+#define MAXNAME 64
+
+// Appends val to a growable array
+#define PUSH(arr, len, cap, val) do { \
+        if ((len) == (cap)) { \
+            (cap) = (cap) ? 2 * (cap) : 64; \
+            (arr) = realloc((arr), (cap) * sizeof(*(arr))); \
+        } \
+        (arr)[(len)++] = (val); \
+    } while (0)
+
+typedef struct
+{
+    int lhs;
+    int start, len;   // right side is rhs[start..start+len-1]
+} Production;
+
+typedef struct
+{
+    int kernel_start, kernel_len;  // sorted items in kernel_items[]
+    int trans_start, trans_len;    // transitions sorted by symbol
+} State;
+
+typedef struct
+{
+    int sym, target;
+} Transition;
+
+typedef struct
+{
+    int from, to;
+} Edge;
+
+// ---------------- Symbols ----------------
+// While reading, symbols are numbered by first appearance. Afterwards terminals
+// are renumbered 0..num_terms-1 with $ as 0, nonterminals follow from num_terms,
+// and the augmented start symbol $accept is last.
+char **names = NULL;
+int num_names = 0, max_names = 0;
+int *name_hash = NULL, hash_cap = 0;
+int num_terms = 0, num_syms = 0, num_nts = 0;
+int named_notation = 0;          // grammar used "->", print with spaces
+
+// ---------------- Productions ----------------
+// Right sides are stored back to back in rhs[], each one followed by -(p+1)
+// where p is its production number. An LR(0) item is an index into rhs[]:
+// rhs[item] is the symbol after the dot, or the end marker of a complete item.
+int *rhs = NULL, rhs_len = 0, rhs_cap = 0;
+Production *prods = NULL;
+int num_prods = 0, prod_cap = 0;
+int *nt_prods = NULL, *nt_prod_start = NULL;  // production numbers grouped by lhs
+
+// ---------------- Sets over terminals ----------------
+// One bit per terminal, plus bit num_terms as the LALR propagation marker.
+int set_words;
+uint64_t *first_sets, *follow_sets, *item_first;
+char *nullable, *item_nullable;
+
+#define FIRST(sym) (first_sets + (size_t)((sym) - num_terms) * set_words)
+#define FOLLOW(sym) (follow_sets + (size_t)((sym) - num_terms) * set_words)
+#define ITEM_FIRST(item) (item_first + (size_t)(item) * set_words)
+
+// ---------------- LR(0) automaton ----------------
+State *states = NULL;
+int num_states = 0, state_cap = 0;
+int *kernel_items = NULL, num_kernel_items = 0, kernel_cap = 0;
+Transition *trans = NULL;
+int num_trans = 0, trans_cap = 0;
+int *state_hash = NULL, state_hash_cap = 0;
+
+// ---------------- LALR(1) lookaheads ----------------
+uint64_t *kernel_la;        // lookahead set per kernel item
+uint64_t *nt_la;            // closure lookahead per nonterminal
+int *la_queue, la_head, la_count;
+char *la_state;             // 0 not reached, 1 queued, 2 reached
+
+#define KERNEL_LA(k) (kernel_la + (size_t)(k) * set_words)
+#define NT_LA(sym) (nt_la + (size_t)((sym) - num_terms) * set_words)
+
+// ---------------- Parse tables ----------------
+// ACTION: 0 error, s > 0 shift to state s-1, r < 0 reduce by production -r-1
+// (reducing by production 0, the augmented one, means accept).
+// GOTO: target state or -1, indexed by nonterminal number - num_terms.
+int *action = NULL, *go_to = NULL;
+int sr_conflicts = 0, rr_conflicts = 0;
+int print_actions = 0;
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static int is_nonterminal(int sym) { return sym >= num_terms; }
+
+// ---------------- Reading the grammar ----------------
+static unsigned hash_string(const char *s)
+{
+    unsigned h = 2166136261u;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static void insert_name(int sym)
+{
+    unsigned h = hash_string(names[sym]) & (hash_cap - 1);
+    while (name_hash[h] >= 0)
+        h = (h + 1) & (hash_cap - 1);
+    name_hash[h] = sym;
+}
+
+static void rehash_names(void)
+{
+    memset(name_hash, -1, hash_cap * sizeof(int));
+    for (int i = 0; i < num_names; i++)
+        insert_name(i);
+}
+
+// Looks a name up, -1 if unknown
+static int lookup(const char *name)
+{
+    unsigned h = hash_string(name) & (hash_cap - 1);
+    while (name_hash[h] >= 0)
+    {
+        if (strcmp(names[name_hash[h]], name) == 0)
+            return name_hash[h];
+        h = (h + 1) & (hash_cap - 1);
+    }
+    return -1;
+}
+
+// Returns the number of a name, adding it if new
+static int intern(const char *name)
+{
+    int sym = hash_cap ? lookup(name) : -1;
+    if (sym >= 0)
+        return sym;
+    PUSH(names, num_names, max_names, strdup(name));
+    if (2 * num_names > hash_cap)
+    {
+        hash_cap = hash_cap ? 2 * hash_cap : 256;
+        name_hash = realloc(name_hash, hash_cap * sizeof(int));
+        rehash_names();
+    }
+    else
+        insert_name(num_names - 1);
+    return num_names - 1;
+}
+
+static void end_production(Production p)
+{
+    p.len = rhs_len - p.start;
+    PUSH(prods, num_prods, prod_cap, p);
+    PUSH(rhs, rhs_len, rhs_cap, -num_prods);  // end marker -(p+1)
+}
+
+// Adds one grammar line; symbols are name numbers until renumber_symbols()
+static void add_production(char *line)
+{
+    char name[MAXNAME + 1], *arrow = strstr(line, "->");
+    Production p = { 0, rhs_len, 0 };
+
+    if (arrow)
+    {
+        named_notation = 1;
+        *arrow = '\0';
+        if (sscanf(line, "%64s", name) != 1)
+        {
+            printf("Missing left side: %s\n", arrow + 2);
+            exit(1);
+        }
+        p.lhs = intern(name);
+        for (char *tok = strtok(arrow + 2, " \t"); tok; tok = strtok(NULL, " \t"))
+            if (strcmp(tok, "#") != 0)
+                PUSH(rhs, rhs_len, rhs_cap, intern(tok));
+    }
+    else
+    {
+        if (line[1] != '=')
+        {
+            printf("Invalid production: %s\n", line);
+            exit(1);
+        }
+        name[1] = '\0';
+        name[0] = line[0];
+        p.lhs = intern(name);
+        for (char *c = line + 2; *c; c++)
+        {
+            if (*c == '#' || isspace((unsigned char)*c))
+                continue;
+            name[0] = *c;
+            PUSH(rhs, rhs_len, rhs_cap, intern(name));
+        }
+    }
+    end_production(p);
+}
+
+static void read_grammar(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char *line = NULL;
+    size_t cap = 0;
+
+    if (!fp)
+    {
+        printf("Cannot open %s\n", path);
+        exit(1);
+    }
+    intern("$");
+    // production 0 is $accept -> S, S is filled in once the first line is read
+    PUSH(rhs, rhs_len, rhs_cap, 0);
+    end_production((Production){ intern("$accept"), 0, 0 });
+
+    while (getline(&line, &cap, fp) != -1)
+    {
+        char *p = line;
+        p[strcspn(p, "\r\n")] = '\0';
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0' || strncmp(p, "//", 2) == 0)
+            continue;
+        add_production(p);
+    }
+    free(line);
+    fclose(fp);
+    if (num_prods < 2)
+    {
+        printf("No productions in %s\n", path);
+        exit(1);
+    }
+    rhs[prods[0].start] = prods[1].lhs;
+}
+
+// Renumbers symbols so terminals come first, then nonterminals, $accept last
+static void renumber_symbols(void)
+{
+    char *is_lhs = calloc(num_names, 1), **sorted = malloc(num_names * sizeof(char *));
+    int *number = malloc(num_names * sizeof(int)), accept = prods[0].lhs;
+
+    for (int p = 0; p < num_prods; p++)
+        is_lhs[prods[p].lhs] = 1;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < num_names; i++)
+            if (is_lhs[i] == pass && i != accept)
+            {
+                number[i] = num_syms;
+                sorted[num_syms++] = names[i];
+            }
+        if (pass == 0)
+            num_terms = num_syms;
+    }
+    number[accept] = num_syms;
+    sorted[num_syms++] = names[accept];
+    num_nts = num_syms - num_terms;
+
+    for (int p = 0; p < num_prods; p++)
+        prods[p].lhs = number[prods[p].lhs];
+    for (int i = 0; i < rhs_len; i++)
+        if (rhs[i] >= 0)
+            rhs[i] = number[rhs[i]];
+    free(names);
+    names = sorted;
+    rehash_names();
+    free(is_lhs);
+    free(number);
+
+    // group productions by left side
+    nt_prod_start = calloc(num_nts + 1, sizeof(int));
+    nt_prods = malloc(num_prods * sizeof(int));
+    for (int p = 0; p < num_prods; p++)
+        nt_prod_start[prods[p].lhs - num_terms + 1]++;
+    for (int n = 0; n < num_nts; n++)
+        nt_prod_start[n + 1] += nt_prod_start[n];
+    int *fill = malloc(num_nts * sizeof(int));
+    memcpy(fill, nt_prod_start, num_nts * sizeof(int));
+    for (int p = 0; p < num_prods; p++)
+        nt_prods[fill[prods[p].lhs - num_terms]++] = p;
+    free(fill);
+}
+
+static void print_production(int p)
+{
+    printf("%s%s", names[prods[p].lhs], named_notation ? " ->" : "=");
+    if (prods[p].len == 0)
+        printf("%s", named_notation ? "" : "#");
+    for (int i = prods[p].start; rhs[i] >= 0; i++)
+        printf(named_notation ? " %s" : "%s", names[rhs[i]]);
+}
+
+// ---------------- FIRST, nullable and FOLLOW ----------------
+// Unions src into dst, returns 1 if dst grew
+static int set_union(uint64_t *dst, const uint64_t *src)
+{
+    uint64_t grew = 0;
+    for (int w = 0; w < set_words; w++)
+    {
+        grew |= src[w] & ~dst[w];
+        dst[w] |= src[w];
+    }
+    return grew != 0;
+}
+
+static void set_bit(uint64_t *set, int bit) { set[bit >> 6] |= 1ULL << (bit & 63); }
+static int test_bit(const uint64_t *set, int bit) { return set[bit >> 6] >> (bit & 63) & 1; }
+
+// Adds FIRST of the rhs suffix starting at item to dst; returns 1 if the suffix can vanish
+static int suffix_first(int item, uint64_t *dst)
+{
+    for (; rhs[item] >= 0; item++)
+    {
+        int sym = rhs[item];
+        if (!is_nonterminal(sym))
+        {
+            set_bit(dst, sym);
+            return 0;
+        }
+        set_union(dst, FIRST(sym));
+        if (!nullable[sym - num_terms])
+            return 0;
+    }
+    return 1;
+}
+
+static void compute_sets(void)
+{
+    uint64_t *temp;
+    int changed;
+
+    first_sets = calloc((size_t)num_nts * set_words, sizeof(uint64_t));
+    follow_sets = calloc((size_t)num_nts * set_words, sizeof(uint64_t));
+    nullable = calloc(num_nts, 1);
+    temp = malloc(set_words * sizeof(uint64_t));
+    do
+    {
+        changed = 0;
+        for (int p = 0; p < num_prods; p++)
+        {
+            memset(temp, 0, set_words * sizeof(uint64_t));
+            if (suffix_first(prods[p].start, temp) && !nullable[prods[p].lhs - num_terms])
+                nullable[prods[p].lhs - num_terms] = changed = 1;
+            changed |= set_union(FIRST(prods[p].lhs), temp);
+        }
+    } while (changed);
+    free(temp);
+
+    // FIRST and nullable of every right side suffix, used by FOLLOW and the LALR closures
+    item_first = calloc((size_t)rhs_len * set_words, sizeof(uint64_t));
+    item_nullable = calloc(rhs_len, 1);
+    for (int i = 0; i < rhs_len; i++)
+        item_nullable[i] = suffix_first(i, ITEM_FIRST(i));
+
+    set_bit(FOLLOW(prods[0].lhs), 0);
+    do
+    {
+        changed = 0;
+        for (int p = 0; p < num_prods; p++)
+            for (int i = prods[p].start; rhs[i] >= 0; i++)
+            {
+                if (!is_nonterminal(rhs[i]))
+                    continue;
+                changed |= set_union(FOLLOW(rhs[i]), ITEM_FIRST(i + 1));
+                if (item_nullable[i + 1])
+                    changed |= set_union(FOLLOW(rhs[i]), FOLLOW(prods[p].lhs));
+            }
+    } while (changed);
+}
+
+// ---------------- LR(0) item sets ----------------
+static unsigned hash_kernel(const int *items, int n)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < n; i++)
+        h = (h ^ (unsigned)items[i]) * 16777619u;
+    return h;
+}
+
+static void rehash_states(void)
+{
+    state_hash_cap = state_hash_cap ? 2 * state_hash_cap : 1024;
+    state_hash = realloc(state_hash, state_hash_cap * sizeof(int));
+    memset(state_hash, -1, state_hash_cap * sizeof(int));
+    for (int s = 0; s < num_states; s++)
+    {
+        unsigned h = hash_kernel(kernel_items + states[s].kernel_start, states[s].kernel_len) & (state_hash_cap - 1);
+        while (state_hash[h] >= 0)
+            h = (h + 1) & (state_hash_cap - 1);
+        state_hash[h] = s;
+    }
+}
+
+// Returns the state with this sorted kernel, creating it if it is new
+static int find_state(const int *items, int n)
+{
+    if (2 * (num_states + 1) > state_hash_cap)
+        rehash_states();
+    unsigned h = hash_kernel(items, n) & (state_hash_cap - 1);
+    while (state_hash[h] >= 0)
+    {
+        State *s = &states[state_hash[h]];
+        if (s->kernel_len == n && memcmp(kernel_items + s->kernel_start, items, n * sizeof(int)) == 0)
+            return state_hash[h];
+        h = (h + 1) & (state_hash_cap - 1);
+    }
+    State st = { num_kernel_items, n, 0, 0 };
+    for (int i = 0; i < n; i++)
+        PUSH(kernel_items, num_kernel_items, kernel_cap, items[i]);
+    state_hash[h] = num_states;
+    PUSH(states, num_states, state_cap, st);
+    return num_states - 1;
+}
+
+// LR(0) closure of state s into *out, kernel items first; returns the item count.
+// nt_mark[] must not contain stamp on entry.
+static int closure(int s, int **out, int *cap, int *nt_mark, int stamp)
+{
+    int n = 0;
+    for (int k = 0; k < states[s].kernel_len; k++)
+        PUSH(*out, n, *cap, kernel_items[states[s].kernel_start + k]);
+    for (int i = 0; i < n; i++)
+    {
+        int sym = rhs[(*out)[i]];
+        if (sym < 0 || !is_nonterminal(sym) || nt_mark[sym - num_terms] == stamp)
+            continue;
+        nt_mark[sym - num_terms] = stamp;
+        for (int j = nt_prod_start[sym - num_terms]; j < nt_prod_start[sym - num_terms + 1]; j++)
+            PUSH(*out, n, *cap, prods[nt_prods[j]].start);
+    }
+    return n;
+}
+
+// Orders (symbol, item) pairs by symbol, then item
+static int compare_pairs(const void *a, const void *b)
+{
+    const int *x = a, *y = b;
+    if (x[0] != y[0])
+        return x[0] < y[0] ? -1 : 1;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+static void build_lr0(void)
+{
+    int *items = NULL, items_cap = 0, *pairs = NULL, pairs_cap = 0, *kernel = NULL, kernel_cap2 = 0;
+    int *nt_mark = calloc(num_nts, sizeof(int));
+    int start = prods[0].start;
+
+    find_state(&start, 1);
+    for (int s = 0; s < num_states; s++)
+    {
+        int n = closure(s, &items, &items_cap, nt_mark, s + 1), np = 0;
+
+        // (symbol after the dot, advanced item) pairs; sorting groups them into
+        // the sorted kernel of each successor
+        for (int i = 0; i < n; i++)
+            if (rhs[items[i]] >= 0)
+            {
+                PUSH(pairs, np, pairs_cap, rhs[items[i]]);
+                PUSH(pairs, np, pairs_cap, items[i] + 1);
+            }
+        qsort(pairs, np / 2, 2 * sizeof(int), compare_pairs);
+
+        states[s].trans_start = num_trans;
+        for (int i = 0; i < np; )
+        {
+            int sym = pairs[i], k = 0;
+            for (; i < np && pairs[i] == sym; i += 2)
+                PUSH(kernel, k, kernel_cap2, pairs[i + 1]);
+            Transition t = { sym, find_state(kernel, k) };
+            PUSH(trans, num_trans, trans_cap, t);
+        }
+        states[s].trans_len = num_trans - states[s].trans_start;
+    }
+    free(items);
+    free(pairs);
+    free(kernel);
+    free(nt_mark);
+}
+
+static int goto_state(int s, int sym)
+{
+    int lo = states[s].trans_start, hi = lo + states[s].trans_len - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (trans[mid].sym == sym)
+            return trans[mid].target;
+        if (trans[mid].sym < sym)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+// Global number of item in the kernel of state s
+static int kernel_index(int s, int item)
+{
+    int lo = states[s].kernel_start, hi = lo + states[s].kernel_len - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (kernel_items[mid] == item)
+            return mid;
+        if (kernel_items[mid] < item)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+// ---------------- LALR(1) lookaheads ----------------
+// In an LR(1) closure the lookaheads of B -> .g depend only on B, so the closure
+// is one lookahead set per nonterminal, grown with a worklist.
+
+// Grows the closure set of sym by first (and by follow if the rest can vanish)
+static void reach(int sym, const uint64_t *first, int vanishes, const uint64_t *follow,
+                  int *reached, int *num_reached)
+{
+    uint64_t *la = NT_LA(sym);
+    int grew = set_union(la, first);
+    if (vanishes)
+        grew |= set_union(la, follow);
+    if (la_state[sym - num_terms] == 0)
+        reached[(*num_reached)++] = sym;
+    else if (!grew || la_state[sym - num_terms] == 1)
+        return;
+    la_state[sym - num_terms] = 1;
+    la_queue[(la_head + la_count++) % num_nts] = sym;
+}
+
+// LR(1) closure of the kernel items[0..n-1] with lookaheads las (n sets).
+// Lookaheads end up in nt_la, the nonterminals reached in reached[]; returns their count.
+static int closure_lookaheads(const int *items, const uint64_t *las, int n, int *reached)
+{
+    int num_reached = 0;
+
+    la_head = la_count = 0;
+    for (int i = 0; i < n; i++)
+        if (rhs[items[i]] >= 0 && is_nonterminal(rhs[items[i]]))
+            reach(rhs[items[i]], ITEM_FIRST(items[i] + 1), item_nullable[items[i] + 1],
+                  las + (size_t)i * set_words, reached, &num_reached);
+    while (la_count > 0)
+    {
+        int b = la_queue[la_head];
+        la_head = (la_head + 1) % num_nts;
+        la_count--;
+        la_state[b - num_terms] = 2;
+        for (int j = nt_prod_start[b - num_terms]; j < nt_prod_start[b - num_terms + 1]; j++)
+        {
+            int item = prods[nt_prods[j]].start;
+            if (rhs[item] >= 0 && is_nonterminal(rhs[item]))
+                reach(rhs[item], ITEM_FIRST(item + 1), item_nullable[item + 1], NT_LA(b),
+                      reached, &num_reached);
+        }
+    }
+    return num_reached;
+}
+
+static void clear_lookaheads(const int *reached, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        memset(NT_LA(reached[i]), 0, set_words * sizeof(uint64_t));
+        la_state[reached[i] - num_terms] = 0;
+    }
+}
+
+// Lookahead la flows through item of state s into the successor's kernel item
+static void pass_lookahead(int s, int item, const uint64_t *la, int from, Edge **edges, int *num_edges, int *cap)
+{
+    if (rhs[item] < 0)
+        return;
+    int to = kernel_index(goto_state(s, rhs[item]), item + 1);
+    set_union(KERNEL_LA(to), la);     // spontaneous lookaheads
+    if (test_bit(la, num_terms))      // the marker: lookaheads of from propagate
+    {
+        Edge e = { from, to };
+        PUSH(*edges, *num_edges, *cap, e);
+    }
+}
+
+// Dragon book lookahead propagation: close every kernel item with a marker
+// lookahead to find spontaneous lookaheads and propagation edges, then push
+// lookaheads along the edges until nothing changes.
+static void build_lalr(void)
+{
+    int *reached = malloc(num_nts * sizeof(int)), num_edges = 0, edge_cap = 0;
+    uint64_t *marker = calloc(set_words, sizeof(uint64_t));
+    Edge *edges = NULL;
+
+    kernel_la = calloc((size_t)num_kernel_items * set_words, sizeof(uint64_t));
+    set_bit(marker, num_terms);
+
+    for (int s = 0; s < num_states; s++)
+        for (int k = states[s].kernel_start; k < states[s].kernel_start + states[s].kernel_len; k++)
+        {
+            int nr = closure_lookaheads(&kernel_items[k], marker, 1, reached);
+            pass_lookahead(s, kernel_items[k], marker, k, &edges, &num_edges, &edge_cap);
+            for (int r = 0; r < nr; r++)
+                for (int j = nt_prod_start[reached[r] - num_terms]; j < nt_prod_start[reached[r] - num_terms + 1]; j++)
+                    pass_lookahead(s, prods[nt_prods[j]].start, NT_LA(reached[r]), k, &edges, &num_edges, &edge_cap);
+            clear_lookaheads(reached, nr);
+        }
+    for (int k = 0; k < num_kernel_items; k++) // drop the marker itself
+        KERNEL_LA(k)[num_terms >> 6] &= ~(1ULL << (num_terms & 63));
+    set_bit(KERNEL_LA(0), 0);                   // $accept -> .S has lookahead $
+
+    // propagation edges grouped by source kernel item
+    int *edge_start = calloc(num_kernel_items + 1, sizeof(int)), *edge_to = malloc((num_edges + 1) * sizeof(int));
+    for (int e = 0; e < num_edges; e++)
+        edge_start[edges[e].from + 1]++;
+    for (int k = 0; k < num_kernel_items; k++)
+        edge_start[k + 1] += edge_start[k];
+    for (int e = 0; e < num_edges; e++)
+        edge_to[edge_start[edges[e].from]++] = edges[e].to;
+    for (int k = num_kernel_items; k > 0; k--) // undo the shift from filling
+        edge_start[k] = edge_start[k - 1];
+    edge_start[0] = 0;
+
+    int *queue = malloc(num_kernel_items * sizeof(int)), head = 0, count = num_kernel_items;
+    char *queued = malloc(num_kernel_items);
+    memset(queued, 1, num_kernel_items);
+    for (int k = 0; k < num_kernel_items; k++)
+        queue[k] = k;
+    while (count > 0)
+    {
+        int k = queue[head];
+        head = (head + 1) % num_kernel_items;
+        count--;
+        queued[k] = 0;
+        for (int e = edge_start[k]; e < edge_start[k + 1]; e++)
+            if (set_union(KERNEL_LA(edge_to[e]), KERNEL_LA(k)) && !queued[edge_to[e]])
+            {
+                queued[edge_to[e]] = 1;
+                queue[(head + count++) % num_kernel_items] = edge_to[e];
+            }
+    }
+    free(queue);
+    free(queued);
+    free(edge_start);
+    free(edge_to);
+    free(edges);
+    free(marker);
+    free(reached);
+}
+
+// ---------------- ACTION and GOTO ----------------
+// Conflicts are reported and resolved like yacc: shift wins over reduce, and
+// the production listed first wins between reductions.
+static void set_action(int s, int term, int value)
+{
+    int *cell = &action[(size_t)s * num_terms + term];
+    if (*cell == 0 || *cell == value)
+    {
+        *cell = value;
+        return;
+    }
+    if (*cell > 0)
+    {
+        sr_conflicts++;
+        printf("State %d: shift/reduce conflict on %s (shift %d, reduce by ", s, names[term], *cell - 1);
+        print_production(-value - 1);
+        printf(")\n");
+        return;
+    }
+    rr_conflicts++;
+    printf("State %d: reduce/reduce conflict on %s (", s, names[term]);
+    print_production(-*cell - 1);
+    printf(" and ");
+    print_production(-value - 1);
+    printf(")\n");
+    if (value > *cell)
+        *cell = value;
+}
+
+static void add_reductions(int s, int item, const uint64_t *la)
+{
+    int p = -rhs[item] - 1;
+    for (int t = 0; t < num_terms; t++)
+        if (test_bit(la, t))
+            set_action(s, t, -(p + 1));
+}
+
+static void build_tables(int slr)
+{
+    int *reached = malloc(num_nts * sizeof(int)), *items = NULL, items_cap = 0;
+    int *nt_mark = calloc(num_nts, sizeof(int));
+
+    action = calloc((size_t)num_states * num_terms, sizeof(int));
+    go_to = malloc((size_t)num_states * num_nts * sizeof(int));
+    memset(go_to, -1, (size_t)num_states * num_nts * sizeof(int));
+
+    for (int s = 0; s < num_states; s++)
+    {
+        for (int t = states[s].trans_start; t < states[s].trans_start + states[s].trans_len; t++)
+        {
+            if (is_nonterminal(trans[t].sym))
+                go_to[(size_t)s * num_nts + trans[t].sym - num_terms] = trans[t].target;
+            else
+                action[(size_t)s * num_terms + trans[t].sym] = trans[t].target + 1;
+        }
+
+        if (slr) // reduce on FOLLOW of the left side
+        {
+            int n = closure(s, &items, &items_cap, nt_mark, s + 1);
+            for (int i = 0; i < n; i++)
+                if (rhs[items[i]] < 0)
+                    add_reductions(s, items[i], FOLLOW(prods[-rhs[items[i]] - 1].lhs));
+            continue;
+        }
+
+        // LALR: complete kernel items use their own lookaheads, epsilon
+        // productions in the closure use the closure lookaheads
+        int k0 = states[s].kernel_start;
+        int nr = closure_lookaheads(&kernel_items[k0], KERNEL_LA(k0), states[s].kernel_len, reached);
+        for (int k = k0; k < k0 + states[s].kernel_len; k++)
+            if (rhs[kernel_items[k]] < 0)
+                add_reductions(s, kernel_items[k], KERNEL_LA(k));
+        for (int r = 0; r < nr; r++)
+            for (int j = nt_prod_start[reached[r] - num_terms]; j < nt_prod_start[reached[r] - num_terms + 1]; j++)
+                if (prods[nt_prods[j]].len == 0)
+                    add_reductions(s, prods[nt_prods[j]].start, NT_LA(reached[r]));
+        clear_lookaheads(reached, nr);
+    }
+    free(reached);
+    free(items);
+    free(nt_mark);
+}
+
+static void print_tables(void)
+{
+    for (int p = 1; p < num_prods; p++)
+    {
+        printf("%d: ", p);
+        print_production(p);
+        printf("\n");
+    }
+    printf("\nState");
+    for (int t = 0; t < num_terms; t++)
+        printf("\t%s", names[t]);
+    for (int n = 0; n < num_nts - 1; n++) // $accept has no GOTO column
+        printf("\t%s", names[num_terms + n]);
+    printf("\n");
+    for (int s = 0; s < num_states; s++)
+    {
+        printf("%d", s);
+        for (int t = 0; t < num_terms; t++)
+        {
+            int a = action[(size_t)s * num_terms + t];
+            if (a > 0)
+                printf("\ts%d", a - 1);
+            else if (a == -1)
+                printf("\tacc");
+            else if (a < 0)
+                printf("\tr%d", -a - 1);
+            else
+                printf("\t");
+        }
+        for (int n = 0; n < num_nts - 1; n++)
+        {
+            int g = go_to[(size_t)s * num_nts + n];
+            if (g >= 0)
+                printf("\t%d", g);
+            else
+                printf("\t");
+        }
+        printf("\n");
+    }
+}
+
+// ---------------- Compressed tables ----------------
+// ACTION rows are compressed three ways: the most frequent reduction of a row
+// becomes its default (replacing error entries too, so errors are found a few
+// reductions later but before any further shift), rows left identical share one
+// copy, and the remaining entries are packed by row displacement: entry (row, t)
+// lives at row_base[row] + t if check[] there holds the row. GOTO columns are
+// packed the same way with the most frequent target as the column default.
+// Both lookups are one load, one compare and a select.
+int *row_of, *row_base, *row_default, num_rows = 0;
+int *action_value, *action_check, action_len = 0;
+int *goto_base, *goto_default, *goto_value, *goto_check, goto_len = 0;
+int use_dense = 0;
+
+typedef struct
+{
+    int start, len;   // entries in the temporary (index, value) list
+    int id;           // row or column number
+} Line;
+
+// Orders lines by decreasing entry count, so the dense ones are placed first
+static int compare_lines(const void *a, const void *b)
+{
+    return ((const Line *)b)->len - ((const Line *)a)->len;
+}
+
+// First fit packing of lines of (index, value) pairs with indices below width.
+// Stores each line's base and returns the packed length, padded so that
+// base + width never goes past the end.
+static int pack_lines(Line *lines, int num_lines, const int *pairs, int width,
+                      int *base, int **value, int **check)
+{
+    int cap = 0, len = 0, lowest_free = 0;
+    *value = NULL;
+    *check = NULL;
+
+    qsort(lines, num_lines, sizeof(Line), compare_lines);
+    for (int l = 0; l < num_lines; l++)
+    {
+        const int *e = pairs + 2 * lines[l].start;
+        int b = lowest_free - (lines[l].len ? e[0] : 0), fits = 0;
+        if (b < 0)
+            b = 0;
+        while (!fits)
+        {
+            fits = 1;
+            for (int i = 0; i < lines[l].len; i++)
+                if (b + e[2 * i] < len && (*check)[b + e[2 * i]] >= 0)
+                {
+                    fits = 0;
+                    b++;
+                    break;
+                }
+        }
+        base[lines[l].id] = b;
+        if (b + width > cap)
+        {
+            int old = cap;
+            while (cap < b + width)
+                cap = cap ? 2 * cap : 1024;
+            *value = realloc(*value, cap * sizeof(int));
+            *check = realloc(*check, cap * sizeof(int));
+            for (int i = old; i < cap; i++)
+            {
+                (*value)[i] = 0;
+                (*check)[i] = -1;
+            }
+        }
+        if (len < b + width)
+            len = b + width;
+        for (int i = 0; i < lines[l].len; i++)
+        {
+            (*check)[b + e[2 * i]] = lines[l].id;
+            (*value)[b + e[2 * i]] = e[2 * i + 1];
+        }
+        while (lowest_free < len && (*check)[lowest_free] >= 0)
+            lowest_free++;
+    }
+    return len;
+}
+
+static unsigned hash_row(int dflt, const int *e, int n)
+{
+    unsigned h = 2166136261u ^ (unsigned)dflt;
+    for (int i = 0; i < 2 * n; i++)
+        h = (h ^ (unsigned)e[i]) * 16777619u;
+    return h;
+}
+
+static void compress_tables(void)
+{
+    int *pairs = NULL, num_pairs = 0, pair_cap = 0, *count = calloc(num_prods, sizeof(int));
+    int hcap = 1, *row_hash;
+    Line *lines = malloc((num_states > num_nts ? num_states : num_nts) * sizeof(Line));
+
+    while (hcap < 2 * num_states)
+        hcap *= 2;
+    row_hash = malloc(hcap * sizeof(int));
+    memset(row_hash, -1, hcap * sizeof(int));
+    row_of = malloc(num_states * sizeof(int));
+    row_default = malloc(num_states * sizeof(int));
+
+    for (int s = 0; s < num_states; s++)
+    {
+        const int *row = &action[(size_t)s * num_terms];
+        int dflt = 0, best = 0, start = num_pairs / 2;
+
+        // most frequent reduction, never accept
+        for (int t = 0; t < num_terms; t++)
+            if (row[t] < -1 && ++count[-row[t] - 1] > best)
+            {
+                best = count[-row[t] - 1];
+                dflt = row[t];
+            }
+        for (int t = 0; t < num_terms; t++)
+        {
+            if (row[t] < 0)
+                count[-row[t] - 1] = 0;
+            if (row[t] != 0 && row[t] != dflt)
+            {
+                PUSH(pairs, num_pairs, pair_cap, t);
+                PUSH(pairs, num_pairs, pair_cap, row[t]);
+            }
+        }
+
+        // share the row with an identical earlier one
+        int n = num_pairs / 2 - start;
+        unsigned h = hash_row(dflt, pairs + 2 * start, n) & (hcap - 1);
+        while (row_hash[h] >= 0)
+        {
+            Line *o = &lines[row_hash[h]];
+            if (row_default[o->id] == dflt && o->len == n &&
+                memcmp(pairs + 2 * o->start, pairs + 2 * start, 2 * n * sizeof(int)) == 0)
+                break;
+            h = (h + 1) & (hcap - 1);
+        }
+        if (row_hash[h] >= 0)
+        {
+            row_of[s] = lines[row_hash[h]].id;
+            num_pairs = 2 * start;
+            continue;
+        }
+        row_hash[h] = num_rows;
+        row_default[num_rows] = dflt;
+        lines[num_rows] = (Line){ start, n, num_rows };
+        row_of[s] = num_rows++;
+    }
+    row_base = malloc(num_rows * sizeof(int));
+    action_len = pack_lines(lines, num_rows, pairs, num_terms, row_base, &action_value, &action_check);
+
+    // GOTO, one column per nonterminal indexed by state
+    num_pairs = 0;
+    goto_default = malloc(num_nts * sizeof(int));
+    goto_base = malloc(num_nts * sizeof(int));
+    int *target_count = calloc(num_states, sizeof(int));
+    for (int n = 0; n < num_nts; n++)
+    {
+        int dflt = -1, best = 0, start = num_pairs / 2;
+        for (int s = 0; s < num_states; s++)
+        {
+            int g = go_to[(size_t)s * num_nts + n];
+            if (g >= 0 && ++target_count[g] > best)
+            {
+                best = target_count[g];
+                dflt = g;
+            }
+        }
+        for (int s = 0; s < num_states; s++)
+        {
+            int g = go_to[(size_t)s * num_nts + n];
+            if (g >= 0)
+                target_count[g] = 0;
+            if (g >= 0 && g != dflt)
+            {
+                PUSH(pairs, num_pairs, pair_cap, s);
+                PUSH(pairs, num_pairs, pair_cap, g);
+            }
+        }
+        goto_default[n] = dflt;
+        lines[n] = (Line){ start, num_pairs / 2 - start, n };
+    }
+    goto_len = pack_lines(lines, num_nts, pairs, num_states, goto_base, &goto_value, &goto_check);
+
+    free(target_count);
+    free(pairs);
+    free(count);
+    free(lines);
+    free(row_hash);
+}
+
+static void print_table_sizes(void)
+{
+    size_t dense = ((size_t)num_states * num_terms + (size_t)num_states * num_nts) * sizeof(int);
+    size_t packed = ((size_t)num_states + 2 * num_rows + 2 * (size_t)action_len +
+                     2 * (size_t)num_nts + 2 * (size_t)goto_len) * sizeof(int);
+
+    printf("Dense tables: %zu bytes; compressed: %zu bytes (%.1f%%), %d distinct rows, "
+           "%d ACTION and %d GOTO slots\n", dense, packed, 100.0 * packed / dense,
+           num_rows, action_len, goto_len);
+}
+
+static inline int lookup_action(int s, int t)
+{
+    if (use_dense)
+        return action[(size_t)s * num_terms + t];
+    int r = row_of[s], i = row_base[r] + t;
+    return action_check[i] == r ? action_value[i] : row_default[r];
+}
+
+static inline int lookup_goto(int s, int sym)
+{
+    int n = sym - num_terms;
+    if (use_dense)
+        return go_to[(size_t)s * num_nts + n];
+    int i = goto_base[n] + s;
+    return goto_check[i] == n ? goto_value[i] : goto_default[n];
+}
+
+// ---------------- Table cache ----------------
+// The sets and tables are saved in a binary file keyed by a hash of the
+// normalised grammar: a header, then each array at an offset from the start of
+// the file. A later run with the same grammar maps the file and points the
+// table globals into the mapping instead of rebuilding the automaton.
+#define CACHE_MAGIC "LRTABLE"
+#define CACHE_VERSION 1
+#define BYTE_ORDER_MARK 0x01020304u
+
+enum { SEC_FIRST, SEC_FOLLOW, SEC_NULLABLE, SEC_ACTION, SEC_GOTO, SEC_ROW_OF, SEC_ROW_BASE,
+       SEC_ROW_DEFAULT, SEC_ACTION_VALUE, SEC_ACTION_CHECK, SEC_GOTO_BASE, SEC_GOTO_DEFAULT,
+       SEC_GOTO_VALUE, SEC_GOTO_CHECK, NUM_SECTIONS };
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version, byte_order;
+    uint64_t grammar_hash;
+    int32_t slr, num_terms, num_nts, num_states;
+    int32_t sr_conflicts, rr_conflicts, num_rows, action_len, goto_len, unused;
+    uint64_t offset[NUM_SECTIONS], size[NUM_SECTIONS];
+} CacheHeader;
+
+// Array stored in a section
+static const void *section_data(int sec)
+{
+    switch (sec)
+    {
+    case SEC_FIRST:        return first_sets;
+    case SEC_FOLLOW:       return follow_sets;
+    case SEC_NULLABLE:     return nullable;
+    case SEC_ACTION:       return action;
+    case SEC_GOTO:         return go_to;
+    case SEC_ROW_OF:       return row_of;
+    case SEC_ROW_BASE:     return row_base;
+    case SEC_ROW_DEFAULT:  return row_default;
+    case SEC_ACTION_VALUE: return action_value;
+    case SEC_ACTION_CHECK: return action_check;
+    case SEC_GOTO_BASE:    return goto_base;
+    case SEC_GOTO_DEFAULT: return goto_default;
+    case SEC_GOTO_VALUE:   return goto_value;
+    default:               return goto_check;
+    }
+}
+
+// Points the global of a section at mapped data, which is only read afterwards
+static void set_section(int sec, const void *data)
+{
+    void *p = (void *)data;
+    switch (sec)
+    {
+    case SEC_FIRST:        first_sets = p; break;
+    case SEC_FOLLOW:       follow_sets = p; break;
+    case SEC_NULLABLE:     nullable = p; break;
+    case SEC_ACTION:       action = p; break;
+    case SEC_GOTO:         go_to = p; break;
+    case SEC_ROW_OF:       row_of = p; break;
+    case SEC_ROW_BASE:     row_base = p; break;
+    case SEC_ROW_DEFAULT:  row_default = p; break;
+    case SEC_ACTION_VALUE: action_value = p; break;
+    case SEC_ACTION_CHECK: action_check = p; break;
+    case SEC_GOTO_BASE:    goto_base = p; break;
+    case SEC_GOTO_DEFAULT: goto_default = p; break;
+    case SEC_GOTO_VALUE:   goto_value = p; break;
+    default:               goto_check = p; break;
+    }
+}
+
+// Size a section must have for the current grammar and header counts
+static size_t section_size(int sec)
+{
+    size_t sets = (size_t)num_nts * set_words * sizeof(uint64_t);
+    switch (sec)
+    {
+    case SEC_FIRST: case SEC_FOLLOW: return sets;
+    case SEC_NULLABLE:     return num_nts;
+    case SEC_ACTION:       return (size_t)num_states * num_terms * sizeof(int);
+    case SEC_GOTO:         return (size_t)num_states * num_nts * sizeof(int);
+    case SEC_ROW_OF:       return (size_t)num_states * sizeof(int);
+    case SEC_ROW_BASE: case SEC_ROW_DEFAULT: return (size_t)num_rows * sizeof(int);
+    case SEC_ACTION_VALUE: case SEC_ACTION_CHECK: return (size_t)action_len * sizeof(int);
+    case SEC_GOTO_BASE: case SEC_GOTO_DEFAULT: return (size_t)num_nts * sizeof(int);
+    default:               return (size_t)goto_len * sizeof(int);
+    }
+}
+
+// FNV-1a over the productions by symbol name, so both notations of a grammar
+// and differences in spacing or comments give the same key
+static uint64_t hash_grammar(int slr)
+{
+    uint64_t h = 14695981039346656037ULL;
+    #define MIX(byte) (h = (h ^ (unsigned char)(byte)) * 1099511628211ULL)
+    MIX(slr);
+    for (int p = 1; p < num_prods; p++)
+    {
+        for (const char *c = names[prods[p].lhs]; *c; c++)
+            MIX(*c);
+        for (int i = prods[p].start; rhs[i] >= 0; i++)
+        {
+            MIX(0x1f);
+            for (const char *c = names[rhs[i]]; *c; c++)
+                MIX(*c);
+        }
+        MIX(0x1e);
+    }
+    #undef MIX
+    return h;
+}
+
+// Whether n ints are all in lo..hi
+static int in_range(const int *a, size_t n, int lo, int hi)
+{
+    for (size_t i = 0; i < n; i++)
+        if (a[i] < lo || a[i] > hi)
+            return 0;
+    return 1;
+}
+
+// Whether every state, production, row and slot in the mapped tables is one the
+// parser can index with. An action is a state + 1, -(production + 1) or 0, a
+// goto a state or -1, and a base leaves room for a whole row or column.
+static int tables_valid(const char *map, const CacheHeader *hdr)
+{
+    #define SECTION(sec) ((const int *)(map + hdr->offset[sec]))
+    #define COUNT(sec) (hdr->size[sec] / sizeof(int))
+    int valid = in_range(SECTION(SEC_ACTION), COUNT(SEC_ACTION), -num_prods, num_states) &&
+                in_range(SECTION(SEC_ROW_DEFAULT), COUNT(SEC_ROW_DEFAULT), -num_prods, num_states) &&
+                in_range(SECTION(SEC_ACTION_VALUE), COUNT(SEC_ACTION_VALUE), -num_prods, num_states) &&
+                in_range(SECTION(SEC_GOTO), COUNT(SEC_GOTO), -1, num_states - 1) &&
+                in_range(SECTION(SEC_GOTO_DEFAULT), COUNT(SEC_GOTO_DEFAULT), -1, num_states - 1) &&
+                in_range(SECTION(SEC_GOTO_VALUE), COUNT(SEC_GOTO_VALUE), -1, num_states - 1) &&
+                in_range(SECTION(SEC_ROW_OF), COUNT(SEC_ROW_OF), 0, num_rows - 1) &&
+                in_range(SECTION(SEC_ROW_BASE), COUNT(SEC_ROW_BASE), 0, action_len - num_terms) &&
+                in_range(SECTION(SEC_GOTO_BASE), COUNT(SEC_GOTO_BASE), 0, goto_len - num_states);
+    #undef SECTION
+    #undef COUNT
+    return valid;
+}
+
+// Maps the cache and points the tables into it; returns 0 if it does not match
+static int load_cache(const char *path, uint64_t hash, int slr)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(CacheHeader))
+    {
+        close(fd);
+        return 0;
+    }
+    const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    const CacheHeader *hdr = (const CacheHeader *)map;
+    if (memcmp(hdr->magic, CACHE_MAGIC, 8) != 0 || hdr->version != CACHE_VERSION ||
+        hdr->byte_order != BYTE_ORDER_MARK || hdr->grammar_hash != hash || hdr->slr != slr ||
+        hdr->num_terms != num_terms || hdr->num_nts != num_nts)
+    {
+        munmap((void *)map, st.st_size);
+        return 0;
+    }
+    // section_size() reads the counts, which are reset if the cache is rejected
+    // so that the tables are rebuilt from scratch
+    num_states = hdr->num_states;
+    num_rows = hdr->num_rows;
+    action_len = hdr->action_len;
+    goto_len = hdr->goto_len;
+    int ok = num_states > 0 && num_rows > 0 && action_len >= 0 && goto_len >= 0;
+    for (int sec = 0; sec < NUM_SECTIONS && ok; sec++)
+        if (hdr->size[sec] != section_size(sec) || hdr->offset[sec] % 8 != 0 ||
+            hdr->offset[sec] > (uint64_t)st.st_size ||
+            hdr->size[sec] > (uint64_t)st.st_size - hdr->offset[sec])
+            ok = 0;
+    if (!ok || !tables_valid(map, hdr))
+    {
+        num_states = num_rows = action_len = goto_len = 0;
+        munmap((void *)map, st.st_size);
+        return 0;
+    }
+    for (int sec = 0; sec < NUM_SECTIONS; sec++)
+        set_section(sec, map + hdr->offset[sec]);
+    sr_conflicts = hdr->sr_conflicts;
+    rr_conflicts = hdr->rr_conflicts;
+    return 1;
+}
+
+// Writes the cache to a temporary file and renames it, so readers never see half a file
+static void save_cache(const char *path, uint64_t hash, int slr)
+{
+    CacheHeader hdr = { CACHE_MAGIC, CACHE_VERSION, BYTE_ORDER_MARK, hash, slr, num_terms,
+                        num_nts, num_states, sr_conflicts, rr_conflicts, num_rows, action_len,
+                        goto_len, 0, { 0 }, { 0 } };
+    uint64_t offset = sizeof(hdr);
+    char tmp[4096];
+
+    for (int sec = 0; sec < NUM_SECTIONS; sec++)
+    {
+        hdr.offset[sec] = offset;
+        hdr.size[sec] = section_size(sec);
+        offset += (hdr.size[sec] + 7) & ~7ULL; // keep every section 8 byte aligned
+    }
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+    {
+        printf("Cannot write %s\n", tmp);
+        return;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    for (int sec = 0; sec < NUM_SECTIONS; sec++)
+    {
+        static const char pad[8];
+        fwrite(section_data(sec), 1, hdr.size[sec], fp);
+        fwrite(pad, 1, ((hdr.size[sec] + 7) & ~7ULL) - hdr.size[sec], fp);
+    }
+    if (fclose(fp) != 0 || rename(tmp, path) != 0)
+        printf("Cannot write %s\n", path);
+}
+
+// ---------------- Shift-reduce driver ----------------
+int *stack = NULL, stack_cap = 0;
+
+// Parses tokens[0..n-1], which end with $. Every token is shifted once and
+// every reduction pops what was pushed, so the parse is linear in n.
+// Returns -1 on accept, otherwise the position of the offending token.
+static long parse(const int *tokens, long n)
+{
+    int top = 0;
+    long ip = 0;
+
+    if (stack_cap == 0)
+        stack = malloc((stack_cap = 1024) * sizeof(int));
+    stack[0] = 0;
+    while (ip < n)
+    {
+        int a = lookup_action(stack[top], tokens[ip]);
+        if (a > 0)
+        {
+            if (top + 1 == stack_cap)
+                stack = realloc(stack, (stack_cap *= 2) * sizeof(int));
+            stack[++top] = a - 1;
+            if (print_actions)
+                printf("Shift %s, goto state %d\n", names[tokens[ip]], a - 1);
+            ip++;
+        }
+        else if (a < 0)
+        {
+            int p = -a - 1;
+            if (p == 0)
+                return -1;
+            if (top < prods[p].len)   // only a damaged cache pops past the bottom
+                break;
+            top -= prods[p].len;
+            stack[top + 1] = lookup_goto(stack[top], prods[p].lhs);
+            if (stack[++top] < 0)
+                break;
+            if (print_actions)
+            {
+                printf("Reduce by ");
+                print_production(p);
+                printf(", goto state %d\n", stack[top]);
+            }
+        }
+        else
+            break;
+    }
+    return ip;
+}
+
+// Splits a line into terminal numbers ending with $; returns the count, -1 on an unknown token
+static long tokenize(char *line, int **tokens, long *cap)
+{
+    long n = 0;
+    char single[2] = { 0, 0 }, *tok;
+
+    if (named_notation)
+        tok = strtok(line, " \t");
+    else
+        tok = line;
+    while (tok && *tok)
+    {
+        const char *name = tok;
+        if (!named_notation)
+        {
+            if (isspace((unsigned char)*tok))
+            {
+                tok++;
+                continue;
+            }
+            single[0] = *tok++;
+            name = single;
+        }
+        else
+            tok = strtok(NULL, " \t");
+
+        int sym = lookup(name);
+        if (sym <= 0 || is_nonterminal(sym))
+        {
+            printf("Unknown terminal %s\n", name);
+            return -1;
+        }
+        PUSH(*tokens, n, *cap, sym);
+    }
+    PUSH(*tokens, n, *cap, 0);
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    int slr = 0, show_tables = 0, bench = 0, arg = 1;
+    const char *cache_path = NULL;
+
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1]; arg++)
+    {
+        if (strcmp(argv[arg], "-s") == 0)
+            slr = 1;
+        else if (strcmp(argv[arg], "-t") == 0)
+            show_tables = 1;
+        else if (strcmp(argv[arg], "-v") == 0)
+            print_actions = 1;
+        else if (strcmp(argv[arg], "-d") == 0)
+            use_dense = 1;
+        else if (strcmp(argv[arg], "-b") == 0)
+            bench = 1;
+        else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc)
+            cache_path = argv[++arg];
+        else
+            break;
+    }
+    if (arg >= argc)
+    {
+        printf("Usage: %s [-s] [-t] [-v] [-d] [-b] [-c cache] grammar [input]\n", argv[0]);
+        return 1;
+    }
+
+    double start = now_ms();
+    read_grammar(argv[arg]);
+    renumber_symbols();
+    uint64_t hash = hash_grammar(slr);
+    set_words = (num_terms + 1 + 63) / 64;
+    if (cache_path && load_cache(cache_path, hash, slr))
+    {
+        printf("%s tables for %d productions loaded from %s in %.2f ms\n", slr ? "SLR(1)" : "LALR(1)",
+               num_prods - 1, cache_path, now_ms() - start);
+        printf("%d shift/reduce, %d reduce/reduce conflicts\n", sr_conflicts, rr_conflicts);
+    }
+    else
+    {
+        compute_sets();
+        build_lr0();
+        la_queue = malloc(num_nts * sizeof(int));
+        la_state = calloc(num_nts, 1);
+        nt_la = calloc((size_t)num_nts * set_words, sizeof(uint64_t));
+        if (!slr)
+            build_lalr();
+        build_tables(slr);
+        compress_tables();
+        printf("%s tables: %d productions, %d terminals, %d nonterminals, %d states, "
+               "%d kernel items, built in %.2f ms\n", slr ? "SLR(1)" : "LALR(1)", num_prods - 1,
+               num_terms - 1, num_nts - 1, num_states, num_kernel_items, now_ms() - start);
+        printf("%d shift/reduce, %d reduce/reduce conflicts\n", sr_conflicts, rr_conflicts);
+        if (cache_path)
+            save_cache(cache_path, hash, slr);
+    }
+    print_table_sizes();
+    if (show_tables)
+        print_tables();
+
+    FILE *in = stdin;
+    if (arg + 1 < argc && strcmp(argv[arg + 1], "-") != 0 && !(in = fopen(argv[arg + 1], "r")))
+    {
+        printf("Cannot open %s\n", argv[arg + 1]);
+        return 1;
+    }
+    char *line = NULL;
+    size_t cap = 0;
+    int *tokens = NULL;
+    long token_cap = 0, total = 0;
+    double parse_time = 0, dense_time = 0;
+    while (getline(&line, &cap, in) != -1)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        long n = tokenize(line, &tokens, &token_cap);
+        if (n < 0)
+            continue;
+        if (bench)
+        {
+            use_dense = 1;
+            double t = now_ms();
+            long dense_err = parse(tokens, n);
+            dense_time += now_ms() - t;
+            use_dense = 0;
+            t = now_ms();
+            long err = parse(tokens, n);
+            parse_time += now_ms() - t;
+            total += n;
+            if (err != dense_err)
+                printf("Dense and compressed tables disagree\n");
+            continue;
+        }
+        double t = now_ms();
+        long err = parse(tokens, n);
+        parse_time += now_ms() - t;
+        total += n;
+        if (err < 0)
+            printf("Input accepted\n");
+        else
+            printf("Input rejected at token %ld (%s)\n", err + 1, names[tokens[err]]);
+    }
+    if (total && bench)
+        printf("Parsed %ld tokens: dense %.2f ms (%.1f Mtokens/s), compressed %.2f ms (%.1f Mtokens/s)\n",
+               total, dense_time, total / dense_time / 1e3, parse_time, total / parse_time / 1e3);
+    else if (total)
+        printf("Parsed %ld tokens in %.2f ms\n", total, parse_time);
+    return 0;
+}
@@ -1,62 +1,422 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
 #define NUMPROD 6 //Specify number of productions
 #define MAXPRODLEN 10 //Maximum length of a single production
-#define MAX 50 //Maximum size of input string and stack
+#define CHUNK 65536 //Size of the blocks the input is read in
+#define NUMLEVELS 2 //Number of precedence levels
 
 //Specify the productions here.
 char productions[NUMPROD][MAXPRODLEN]={"E=E+E","E=E*E","E=i","E=(E)","E=E-E","E=E/E"};
+//Operators of the same level, lowest level first. All are left associative
+//(like %left in 5pgm/Exp.y); used where the grammar alone is ambiguous.
+char *precedence[NUMLEVELS]={"+-","*/"};
 char *ptr_prod = &productions[0][0]; //Declare a pointer to the productions table
-char input[MAX]={0},stack[MAX]={0};
-short top = -1,ip_ptr=0; //pointers to the top of the stack and input string
+int rhs_len[NUMPROD]; //length of the right hand side of each production
+char *stack=NULL; //grows as needed, kept null terminated for printing
+long stack_cap=0;
+//The input is read from in through a fixed size buffer, so memory use does not
+//depend on its length. Input from a terminal ends at the end of the first line.
+FILE *in;
+char input[CHUNK+1]={0};
+long input_len=0;
+long long input_offset=0; //position of input[0] in the whole input
+int stop_at_newline=0;
+long top = -1,ip_ptr=0; //pointers to the top of the stack and into the input buffer
+int verbose = 1; //print every action, cleared by -q
+long shifts=0,reductions=0,max_depth=0; //counters reported in quiet mode
+//Optional trace of the last actions, kept in binary form and only formatted when
+//a parse fails. The ring holds a power of two records, the oldest are overwritten.
+enum {TRACE_SHIFT,TRACE_REDUCE,TRACE_ERROR};
+struct trace
+{
+    uint8_t action;
+    char symbol; //symbol shifted or lookahead at an error
+    int8_t prodno; //production reduced by, -1 otherwise
+    uint32_t depth; //stack depth after the action
+    int64_t position; //input consumed before the action
+};
+struct trace *ring=NULL;
+uint64_t ring_mask=0,ring_count=0;
+//Operator precedence relations between terminals: '<' yields precedence (shift),
+//'=' same handle (shift), '>' takes precedence (reduce), 0 is an error.
+char relation[128][128]={{0}};
+//LEADING and TRAILING sets of the non terminals, indexed by the letter
+char leading[128][128]={{0}},trailing[128][128]={{0}};
 //Prototypes of shift & reduce
 void shift(char symb);
 void reduce(int prodno,char *stackpos); //takes production number and handle location as args
 
-int main()
-{
-    printf("Enter the string to be parsed: ");
-    scanf("%[^\n]",input);
-    getchar();//remove extra new line from i/p stream.
-    printf("\nSHIFT-REDUCE PARSING\n");
-    printf("Stack\t\tInput\t\tAction\n");
-    printf("-----\t\t-----\t\t------\n");
-    while(input[ip_ptr]!='\0') //till the end of the input
-    {
-       shift(input[ip_ptr++]);
-       for(int j=0;j<NUMPROD;j++) //continuously reduce
+int is_terminal(char c)
+{
+    return !isupper((unsigned char)c);
+}
+//Level of an operator in the precedence table, -1 if it has none
+int level(char c)
+{
+    for(int i=0;i<NUMLEVELS;i++)
+        if(strchr(precedence[i],c))
+            return i;
+    return -1;
+}
+//Records a relation. Conflicting relations between operators are settled by
+//their levels, a higher level takes precedence and equal levels associate left.
+void set_relation(char a,char b,char rel)
+{
+    if(relation[(unsigned char)a][(unsigned char)b]==0||relation[(unsigned char)a][(unsigned char)b]==rel)
+    {
+        relation[(unsigned char)a][(unsigned char)b]=rel;
+        return;
+    }
+    if(level(a)<0||level(b)<0)
+    {
+        printf("Grammar is not operator precedence: %c %c\n",a,b);
+        exit(1);
+    }
+    relation[(unsigned char)a][(unsigned char)b] = level(a)>=level(b) ? '>' : '<';
+}
+//Adds all members of src to dest, returns 1 if dest changed
+int add_all(char *dest,char *src)
+{
+    int changed=0;
+    for(int c=0;c<128;c++)
+        if(src[c]&&!dest[c])
+            dest[c]=changed=1;
+    return changed;
+}
+//Builds the relation table from the productions using LEADING and TRAILING sets
+void build_relations()
+{
+    int changed;
+    for(int i=0;i<NUMPROD;i++) //the tables are indexed by symbol, so only ASCII fits
+        for(char *p=productions[i];*p;p++)
+            if((unsigned char)*p>=128)
+            {
+                printf("Grammar symbols must be ASCII: %s\n",productions[i]);
+                exit(1);
+            }
+    do //LEADING(A) has a from A=a.. or A=Ba.., and LEADING(B) from A=B..
+    {  //TRAILING(A) is the mirror image, looking from the right end
+        changed=0;
         for(int i=0;i<NUMPROD;i++)
         {
-            //find the begining of the handle in the stack
-            char *pos = strstr(stack,(ptr_prod+i*MAXPRODLEN+2));
-            if(pos!=NULL)
+            char A=productions[i][0],*rhs=productions[i]+2;
+            int n=rhs_len[i]=strlen(rhs);
+            if(is_terminal(rhs[0]))
+                changed|=!leading[(unsigned char)A][(unsigned char)rhs[0]],leading[(unsigned char)A][(unsigned char)rhs[0]]=1;
+            else
+            {
+                changed|=add_all(leading[(unsigned char)A],leading[(unsigned char)rhs[0]]);
+                if(n>1&&is_terminal(rhs[1]))
+                    changed|=!leading[(unsigned char)A][(unsigned char)rhs[1]],leading[(unsigned char)A][(unsigned char)rhs[1]]=1;
+            }
+            if(is_terminal(rhs[n-1]))
+                changed|=!trailing[(unsigned char)A][(unsigned char)rhs[n-1]],trailing[(unsigned char)A][(unsigned char)rhs[n-1]]=1;
+            else
+            {
+                changed|=add_all(trailing[(unsigned char)A],trailing[(unsigned char)rhs[n-1]]);
+                if(n>1&&is_terminal(rhs[n-2]))
+                    changed|=!trailing[(unsigned char)A][(unsigned char)rhs[n-2]],trailing[(unsigned char)A][(unsigned char)rhs[n-2]]=1;
+            }
+        }
+    }while(changed);
+
+    for(int i=0;i<NUMPROD;i++)
+    {
+        char *rhs=productions[i]+2;
+        for(int j=0;rhs[j+1]!='\0';j++)
+        {
+            char x=rhs[j],y=rhs[j+1];
+            if(is_terminal(x)&&is_terminal(y))
+                set_relation(x,y,'=');
+            if(is_terminal(x)&&!is_terminal(y)&&rhs[j+2]!='\0'&&is_terminal(rhs[j+2]))
+                set_relation(x,rhs[j+2],'=');
+            for(int c=0;c<128;c++)
+            {
+                if(is_terminal(x)&&!is_terminal(y)&&leading[(unsigned char)y][c])
+                    set_relation(x,c,'<');
+                if(!is_terminal(x)&&is_terminal(y)&&trailing[(unsigned char)x][c])
+                    set_relation(c,y,'>');
+            }
+        }
+    }
+    for(int c=0;c<128;c++) //$ marks both ends of the input
+    {
+        if(leading[(unsigned char)productions[0][0]][c])
+            set_relation('$',c,'<');
+        if(trailing[(unsigned char)productions[0][0]][c])
+            set_relation(c,'$','>');
+    }
+}
+//Index of the topmost terminal in the stack. No two non terminals are ever
+//adjacent in an operator grammar, so it is at most one below the top.
+long top_terminal()
+{
+    return is_terminal(stack[top]) ? top : top-1;
+}
+//Appends a record to the trace ring, if there is one
+void trace(int action,char symbol,int prodno)
+{
+    if(ring==NULL)
+        return;
+    struct trace *r=&ring[ring_count++&ring_mask];
+    r->action=action;
+    r->symbol=symbol;
+    r->prodno=prodno;
+    r->depth=top;
+    r->position=input_offset+ip_ptr;
+}
+//Prints the records in the trace ring, oldest first
+void dump_trace()
+{
+    uint64_t first = ring_count>ring_mask+1 ? ring_count-ring_mask-1 : 0;
+    printf("Last %llu actions:\n",(unsigned long long)(ring_count-first));
+    printf("#\t\tAction\t\tDepth\t\tPosition\n");
+    for(uint64_t i=first;i<ring_count;i++)
+    {
+        struct trace *r=&ring[i&ring_mask];
+        printf("%llu\t\t",(unsigned long long)i);
+        if(r->action==TRACE_SHIFT)
+            printf("shift %c",r->symbol);
+        else if(r->action==TRACE_REDUCE)
+            printf("reduce %s",productions[(int)r->prodno]);
+        else
+            printf("error at %c",r->symbol);
+        printf("\t\t%u\t\t%lld\n",r->depth,(long long)r->position);
+    }
+}
+//Records a syntax error, returns 0 so the parse can be abandoned with it
+int reject(char b)
+{
+    trace(TRACE_ERROR,b,-1);
+    return 0;
+}
+//Reads the next chunk of input, returns 0 at the end of the input
+int refill()
+{
+    if(stop_at_newline&&input_len>0&&input[input_len-1]=='\n')
+        return 0;
+    input_offset+=input_len;
+    if(stop_at_newline)
+        input_len=fgets(input,CHUNK+1,in) ? strlen(input) : 0;
+    else
+        input_len=fread(input,1,CHUNK,in);
+    input[input_len]='\0';
+    ip_ptr=0;
+    return input_len>0;
+}
+//Next input symbol, $ at the end; blanks and line breaks are skipped
+char lookahead()
+{
+    while(1)
+    {
+        if(ip_ptr==input_len&&!refill())
+            return '$';
+        char c=input[ip_ptr];
+        if(c!=' '&&c!='\t'&&c!='\n'&&c!='\r')
+            return c;
+        ip_ptr++;
+    }
+}
+//Parses input, returns 1 if it is accepted
+int parse()
+{
+    top=-1;
+    ip_ptr=input_len=0;
+    input_offset=0;
+    input[0]='\0';
+    shifts=reductions=max_depth=0;
+    ring_count=0;
+    shift('$');
+    shifts=0; //the bottom marker is not counted
+    while(1)
+    {
+        char b=lookahead();
+        if((unsigned char)b>=128) //no relation can hold for a symbol outside ASCII
+            return reject(b);
+        if(b=='$'&&ip_ptr<input_len) //a $ in the input is not the end marker
+            return reject(b);
+        long t=top_terminal();
+        char a=stack[t];
+        if(a=='$'&&b=='$')
+            return top==1&&stack[top]==productions[0][0] ? 1 : reject(b);
+        char rel=relation[(unsigned char)a][(unsigned char)b];
+        if(rel=='<'||rel=='=')
+        {
+            shift(b); //traced at the position of b, which is consumed after
+            ip_ptr++;
+        }
+        else if(rel=='>')
+        {
+            //pop terminals until the one below yields precedence to the last popped
+            long k=t-(is_terminal(stack[t-1])?1:2);
+            while(k>0&&relation[(unsigned char)stack[k]][(unsigned char)stack[t]]!='<')
+            {
+                t=k;
+                k=t-(is_terminal(stack[t-1])?1:2);
+            }
+            if(relation[(unsigned char)stack[k]][(unsigned char)stack[t]]!='<')
+                return reject(b);
+            //the handle is everything above stack[k]
+            int prodno=-1;
+            for(int i=0;i<NUMPROD;i++)
+                if(rhs_len[i]==top-k&&memcmp(ptr_prod+i*MAXPRODLEN+2,stack+k+1,top-k)==0)
+                    prodno=i;
+            if(prodno<0)
+                return reject(b);
+            reduce(prodno,stack+k+1);
+        }
+        else
+            return reject(b);
+    }
+}
+//Times parses of generated expressions of growing size, without printing.
+//With -t the trace ring is kept during the parse.
+void benchmark()
+{
+    char ops[]="+-*/";
+    verbose=0;
+    printf("Tokens\t\tTime(ms)\tns/token\n");
+    for(long n=1000;n<=1000000;n*=10)
+    {
+        //i+i*i-(i/i)+... keeps the stack shallow whatever the length
+        char *expr=malloc(n+8);
+        long len=0;
+        expr[len++]='i';
+        for(long k=1;len<n;k++)
+        {
+            expr[len++]=ops[k%4];
+            if(k%5==0)
             {
-                reduce(i,pos);
+                memcpy(expr+len,"(i+i)",5);
+                len+=5;
             }
+            else
+                expr[len++]='i';
         }
+        expr[len]='\0';
+        in=fmemopen(expr,len,"r");
+        struct timespec start,end;
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        int ok=parse();
+        clock_gettime(CLOCK_MONOTONIC,&end);
+        fclose(in);
+        double ms=(end.tv_sec-start.tv_sec)*1e3+(end.tv_nsec-start.tv_nsec)/1e6;
+        printf("%ld\t\t%.2f\t\t%.1f%s\n",len,ms,ms*1e6/len,ok?"":"\t(rejected)");
+        free(expr);
     }
-    //After the input is finished
-    if(top==0&&stack[top]=='E')
+}
+
+//Usage: ./a.out [-b] [-q] [-t records] [file]
+//  -b  benchmark the parser on generated expressions
+//  -q  quiet, only report acceptance and the action counters
+//  -t  keep a trace of the last records actions, dumped if the input is rejected
+//Without a file the input is read from stdin.
+int main(int argc,char *argv[])
+{
+    int bench=0,opt;
+    while((opt=getopt(argc,argv,"bqt:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'b': bench=1; break;
+            case 'q': verbose=0; break;
+            case 't':
+            {
+                long records=atol(optarg);
+                if(records<1)
+                {
+                    printf("Trace size must be positive\n");
+                    return 1;
+                }
+                ring_mask=1;
+                while((long)ring_mask<records)
+                    ring_mask*=2;
+                ring=malloc(ring_mask*sizeof(struct trace));
+                ring_mask--;
+                break;
+            }
+            default:
+                printf("Usage: %s [-b] [-q] [-t records] [file]\n",argv[0]);
+                return 1;
+        }
+    }
+    build_relations();
+    if(bench)
+    {
+        benchmark();
+        return 0;
+    }
+    if(optind<argc)
+    {
+        in=fopen(argv[optind],"r");
+        if(in==NULL)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    else
+    {
+        in=stdin;
+        stop_at_newline=isatty(fileno(stdin));
+        if(stop_at_newline)
+            printf("Enter the string to be parsed: ");
+    }
+    if(verbose)
+    {
+        printf("\nSHIFT-REDUCE PARSING\n");
+        printf("Stack\t\tInput\t\tAction\n");
+        printf("-----\t\t-----\t\t------\n");
+    }
+    int accepted=parse();
+    if(accepted)
     {
         printf("Input accepted\n");
     }
     else
     {
-        printf("Input rejected\n");
+        printf("Input rejected at position %lld\n",input_offset+ip_ptr);
+        if(ring)
+            dump_trace();
     }
+    if(!verbose)
+        printf("Shifts: %ld, Reductions: %ld, Maximum stack depth: %ld\n",shifts,reductions,max_depth);
+    return !accepted;
 }
 void shift(char c)
 {
+    if(top+2>=stack_cap) //room for c and the terminating null
+    {
+        stack_cap = stack_cap ? 2*stack_cap : 64;
+        stack = realloc(stack,stack_cap);
+        if(stack==NULL)
+        {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
     stack[++top]=c;
-    printf("%s\t\t%s\t\tShifted %c to stack\n",stack,(input+ip_ptr),c);
+    stack[top+1]='\0';
+    shifts++;
+    if(top>max_depth)
+        max_depth=top;
+    trace(TRACE_SHIFT,c,-1);
+    if(verbose&&c!='$') //c is input[ip_ptr], the rest of the input follows it
+        printf("%s\t\t%.*s\t\tShifted %c to stack\n",stack+1,(int)strcspn(input+ip_ptr+1,"\n"),(input+ip_ptr+1),c);
 }
 
 void reduce(int prodno,char *stackpos)
 {
-    int len = strlen(stackpos);
-    top -= len;
-    bzero((stack+top+1),len);
-    stack[++top] = productions[prodno][0];
-    printf("%s\t\t%s\t\tReduced by the production %s\n",stack,(input+ip_ptr),productions[prodno]);
-}
\ No newline at end of file
+    top = stackpos-stack; //the handle is popped, its first symbol is replaced
+    stack[top] = productions[prodno][0];
+    stack[top+1]='\0';
+    reductions++;
+    trace(TRACE_REDUCE,0,prodno);
+    if(verbose)
+        printf("%s\t\t%.*s\t\tReduced by the production %s\n",stack+1,(int)strcspn(input+ip_ptr,"\n"),(input+ip_ptr),productions[prodno]);
+}
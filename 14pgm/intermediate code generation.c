@@ -1,14 +1,261 @@
 #include <stdio.h>     // Standard I/O functions (printf, fgets)
-#include <string.h>    // String utilities (strcspn)
+#include <stdlib.h>    // Memory allocation (malloc, realloc)
+#include <string.h>    // String utilities (strcspn, memcmp)
 #include <ctype.h>     // Character classification (isalnum, isspace, etc.)
+#include <limits.h>    // LLONG_MIN for constant folding
+#include <time.h>      // clock_gettime for timing the optimiser
 
-#define VARLEN 32      // Max length of a variable/operand string stored
-#define MAXSIZE 100    // Max number of entries in operator/operand stacks
+#define BATCH 65536    // Instructions collected before they are optimised and printed
 
-char opndstack[MAXSIZE][VARLEN]; // Stack to hold operand strings (identifiers, temps)
-char opstack[MAXSIZE];           // Stack to hold operators as characters
+/* The generated code is kept in memory as quadruples (op, arg1, arg2, result).
+   Operands are ints: a value >= 0 is the id of an interned name or number in
+   the symbol table, a value < 0 is the temporary t(-value). */
+#define TEMP(n) (-(n))             // operand for temporary tn
+#define IS_TEMP(x) ((x) < 0)
+#define NO_OPND 0x7fffffff         // unused operand (arg2 of a copy)
+
+typedef struct {
+	char op;        // '+', '-', '*', '/', or '=' for a copy result = arg1, see below
+	int arg1, arg2; // operands
+	int result;     // name or temporary assigned, label number for labels and jumps
+} Quad;
+
+/* Control flow: 'L' is the label Lresult, 'j' is goto Lresult, and a relation
+   ('<', '>', 'l' for <=, 'g' for >=, 'e' for ==, 'n' for !=) is
+   if arg1 relation arg2 goto Lresult. Until a jump is backpatched its result
+   links it to the next jump in the same jump list. */
+#define IS_CJUMP(op) ((op) != '\0' && strchr("<>lgen", (op)) != NULL)
+#define IS_JUMP(op) ((op) == 'j' || IS_CJUMP(op))
+#define DEFINES(op) ((op) != 'L' && !IS_JUMP(op))  // assigns its result
+#define NARGS(op) ((op) == '=' ? 1 : (op) == 'L' || (op) == 'j' ? 0 : 2)
+
+/* A list of jumps waiting for the same target, threaded through their result
+   fields, so two lists are merged in constant time */
+typedef struct {
+	int head, tail; // first and last jump, -1 = empty list
+} JumpList;
+
+Quad *code = NULL;                 // Generated code, grows as needed
+int ncode = 0, codecap = 0;        // Number of quadruples and allocated size
+
+/* Symbol table: every distinct name is stored once, found through a hash
+   table of ids (open addressing, -1 = empty slot) */
+char **names = NULL;               // names[id] is the text of symbol id
+int nnames = 0, namecap = 0;
+int *hashtab = NULL;               // ids by hash of their text
+int hashcap = 0;                   // size of hashtab, a power of two
+
+int *opndstack = NULL;           // Stack to hold operand ids (identifiers, temps), grows as needed
+char *opstack = NULL;            // Stack to hold operators as characters, grows as needed
+int opndcap = 0, opcap = 0;      // Allocated sizes of the stacks
 int opstktop = -1, opndstktop = -1; // Top indices for operator and operand stacks (-1 = empty)
-char expn[MAXSIZE*2] = {'\0'};  // Input expression buffer (initialized to empty)
+char *expn = NULL;               // Input line buffer, resized by getline
+size_t expncap = 0;
+int temp_count = 1;              // Next new temporary, numbering continues across statements
+long nstatements = 0;            // Statements translated
+int nlabels = 0;                 // Labels created
+
+/* Basic blocks and the control flow graph. Successors and predecessors are
+   stored compressed: those of block b are succs[succ_start[b]] up to
+   succs[succ_start[b + 1]], and likewise for preds. */
+typedef struct {
+	int start, end; // instructions start up to end (exclusive)
+} Block;
+
+Block *blocks = NULL;
+int nblocks = 0, blockcap = 0;
+int *label_block = NULL;         // block starting with each label
+int label_block_cap = 0;
+int *succ_start = NULL, *succs = NULL, *pred_start = NULL, *preds = NULL;
+int succ_start_cap = 0, succcap = 0, pred_start_cap = 0, predcap = 0;
+
+/* Output is collected in a buffer and written out in large blocks */
+char outbuf[1 << 16];
+int outlen = 0;
+FILE *outfile = NULL;
+
+/* Temporaries are used exactly once, by the operation that pops them, so they
+   go back on a free list right after that and the next operation reuses the
+   most recently freed one. The number of temporaries is then bounded by the
+   depth of the expression rather than its size. */
+int *freetemps = NULL;             // Free temporary numbers, used as a stack
+int nfreetemps = 0, freetempcap = 0;
+int maxtemps = 0;                  // Distinct temporaries used
+
+/* Grow an array so it can hold at least need elements of size bytes,
+   new elements are zeroed */
+static void *grow(void *arr, int *cap, int need, size_t size)
+{
+	if (need <= *cap)
+		return arr;
+	int old = *cap;
+	while (*cap < need)
+		*cap = *cap ? *cap * 2 : 64;      // double the capacity
+	arr = realloc(arr, *cap * size);
+	if (arr == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memset((char *)arr + old * size, 0, (*cap - old) * size);
+	return arr;
+}
+
+/* FNV-1a hash of len characters of s */
+static unsigned hash(const char *s, int len)
+{
+	unsigned h = 2166136261u;
+	for (int i = 0; i < len; i++)
+		h = (h ^ (unsigned char)s[i]) * 16777619u;
+	return h;
+}
+
+/* Return the id of the len characters at s, adding them to the symbol table
+   if they are new */
+int intern(const char *s, int len)
+{
+	if (2 * (nnames + 1) > hashcap) {   // keep the table at most half full
+		hashcap = hashcap ? hashcap * 2 : 256;
+		free(hashtab);
+		hashtab = malloc(hashcap * sizeof(int));
+		memset(hashtab, -1, hashcap * sizeof(int));
+		for (int id = 0; id < nnames; id++) {   // reinsert the existing names
+			unsigned h = hash(names[id], strlen(names[id])) & (hashcap - 1);
+			while (hashtab[h] >= 0)
+				h = (h + 1) & (hashcap - 1);
+			hashtab[h] = id;
+		}
+	}
+	unsigned h = hash(s, len) & (hashcap - 1);
+	while (hashtab[h] >= 0) {               // probe until found or empty
+		char *name = names[hashtab[h]];
+		if (memcmp(name, s, len) == 0 && name[len] == '\0')
+			return hashtab[h];
+		h = (h + 1) & (hashcap - 1);
+	}
+	names = grow(names, &namecap, nnames + 1, sizeof(char *));
+	names[nnames] = malloc(len + 1);
+	memcpy(names[nnames], s, len);
+	names[nnames][len] = '\0';
+	hashtab[h] = nnames;
+	return nnames++;
+}
+
+/* Append a quadruple to the code, returns its index */
+int emit(char op, int arg1, int arg2, int result)
+{
+	code = grow(code, &codecap, ncode + 1, sizeof(Quad));
+	code[ncode].op = op;
+	code[ncode].arg1 = arg1;
+	code[ncode].arg2 = arg2;
+	code[ncode].result = result;
+	return ncode++;
+}
+
+/* Write the output buffer to outfile */
+static void out_flush(void)
+{
+	fwrite(outbuf, 1, outlen, outfile);
+	outlen = 0;
+}
+
+/* Append len characters of s to the output */
+static void out_str(const char *s, int len)
+{
+	if (outlen + len > (int)sizeof(outbuf)) {
+		out_flush();
+		if (len > (int)sizeof(outbuf)) {   // too long to buffer
+			fwrite(s, 1, len, outfile);
+			return;
+		}
+	}
+	memcpy(outbuf + outlen, s, len);
+	outlen += len;
+}
+
+/* Print operand x */
+void print_opnd(int x)
+{
+	if (IS_TEMP(x)) {
+		char buf[16];
+		int i = sizeof(buf);
+		for (unsigned n = -x; n > 0; n /= 10)
+			buf[--i] = '0' + n % 10;     // digits of the number, last first
+		buf[--i] = 't';
+		out_str(buf + i, sizeof(buf) - i);
+	} else
+		out_str(names[x], strlen(names[x]));
+}
+
+/* Print label number n */
+static void print_label(int n)
+{
+	char buf[16];
+	int i = sizeof(buf);
+	do
+		buf[--i] = '0' + n % 10;
+	while ((n /= 10) > 0);
+	buf[--i] = 'L';
+	out_str(buf + i, sizeof(buf) - i);
+}
+
+/* Print one quadruple as three-address code */
+void print_quad(const Quad *q)
+{
+	static const char *relations[] = {"<", ">", "<=", ">=", "==", "!="};
+	char op[3] = {' ', q->op, ' '};
+	if (q->op == 'L') {
+		print_label(q->result);
+		out_str(":\n", 2);
+		return;
+	}
+	if (IS_JUMP(q->op)) {
+		if (q->op != 'j') {
+			const char *rel = relations[strchr("<>lgen", q->op) - "<>lgen"];
+			out_str("if ", 3);
+			print_opnd(q->arg1);
+			out_str(" ", 1);
+			out_str(rel, strlen(rel));
+			out_str(" ", 1);
+			print_opnd(q->arg2);
+			out_str(" ", 1);
+		}
+		out_str("goto ", 5);
+		print_label(q->result);
+		out_str("\n", 1);
+		return;
+	}
+	print_opnd(q->result);
+	out_str(" = ", 3);
+	print_opnd(q->arg1);
+	if (q->op != '=') {
+		out_str(op, 3);
+		print_opnd(q->arg2);
+	}
+	out_str("\n", 1);
+}
+
+/* Text printer for the generated code */
+void print_code(FILE *out)
+{
+	outfile = out;
+	for (int i = 0; i < ncode; i++)
+		print_quad(&code[i]);
+	out_flush();
+}
+
+/* Push operand x on the operand stack */
+static void push_opnd(int x)
+{
+	opndstack = grow(opndstack, &opndcap, opndstktop + 2, sizeof(int));
+	opndstack[++opndstktop] = x;
+}
+
+/* Push operator c on the operator stack */
+static void push_op(char c)
+{
+	opstack = grow(opstack, &opcap, opstktop + 2, sizeof(char));
+	opstack[++opstktop] = c;
+}
 
 /* Return precedence/priority of operator c (higher = higher precedence) */
 int priority(char c)
@@ -20,60 +267,483 @@ int priority(char c)
 	return 0;                             // default fallback
 }
 
+/* Return operand x to the free list if it is a temporary */
+static void free_temp(int x)
+{
+	if (!IS_TEMP(x))
+		return;
+	freetemps = grow(freetemps, &freetempcap, nfreetemps + 1, sizeof(int));
+	freetemps[nfreetemps++] = -x;
+}
+
+/* A free temporary, or a new one numbered from *temp_count */
+static int new_temp(int *temp_count)
+{
+	if (nfreetemps > 0)
+		return TEMP(freetemps[--nfreetemps]);
+	if (*temp_count > maxtemps)
+		maxtemps = *temp_count;
+	return TEMP((*temp_count)++); // increment temporary counter
+}
+
+static void syntax_error(const char *expected);
+
 /* Generate one intermediate code operation using top operator and operands.
    temp_count is pointer to counter for temporary variable numbers. */
 static void gen_op(int *temp_count)
 {
-	if (opndstktop < 1 || opstktop < 0) 
-		return; // Need at least two operands and one operator
+	if (opstktop < 0)
+		return; // no operator to generate
+	if (opndstktop < 1)
+		syntax_error("an operand"); // an operator needs two operands
 
 	char op = opstack[opstktop--];          // Pop operator from operator stack
-	char *right = opndstack[opndstktop--];  // Pop right operand from operand stack
-	char *left = opndstack[opndstktop--];   // Pop left operand from operand stack
+	int right = opndstack[opndstktop--];    // Pop right operand from operand stack
+	int left = opndstack[opndstktop--];     // Pop left operand from operand stack
 
 	if (op == '=') {
 		/* assignment: left = right */
-		printf("%s = %s\n", left, right);   // Emit assignment directly
+		emit('=', right, NO_OPND, left);    // Emit the copy directly
+		free_temp(right);                   // that was the last use of right
 		/* result of assignment is the left operand (address/variable) */
-		snprintf(opndstack[++opndstktop], VARLEN, "%s", left); // push left back as result
+		push_opnd(left);                    // push left back as result
+	} else {
+		/* the operands are dead once read, so the result may reuse one */
+		free_temp(right);
+		free_temp(left);
+		int result = new_temp(temp_count);
+		/* For binary operators, emit a temporary tN = left op right */
+		emit(op, left, right, result);
+		/* push the temporary onto operand stack as result of this op */
+		push_opnd(result);
+	}
+}
+
+/* ---------------- Local optimisation of a basic block ----------------
+   Value numbering builds the DAG of the block while scanning it: every
+   operand maps to a value, an operator applied to the same values again gives
+   the same value (common subexpression), an operator on constants gives a
+   constant (folding) and a copy makes its target share the value of its
+   source (copy propagation). Each value keeps a list of the operands holding
+   it, and uses are rewritten to the oldest one still holding it, so the copies
+   emitted for reused values become dead. Dead assignments are then removed,
+   and a temporary that is only copied into another operand is replaced by it.
+   Every step is linear in the length of the block. */
+
+typedef struct {
+	char op;        // operator, 'k' for a constant, 'l' for an operand's value on entry
+	int l, r;       // operand values of an operator
+	long long k;    // value of a constant
+	int holders;    // first entry of the holder list, -1 = none
+} Value;
+
+typedef struct {
+	int opnd;       // operand holding the value, if its current value is still it
+	int next;       // next entry, -1 = end of list
+} Holder;
+
+typedef struct {
+	unsigned stamp; // pass the fields below belong to, stale fields are reset
+	int val;        // current value, -1 = not seen yet
+	int live;       // value is used later (dead code removal)
+	int def_in;     // input index of the instruction defining it (copy coalescing)
+	int def_out;    // output index of that instruction
+	int lastref;    // output index of the last instruction reading or writing it
+} OpndInfo;
+
+typedef struct {
+	unsigned stamp; // pass the entry belongs to
+	int val;        // value stored in this slot
+} ValSlot;
+
+Value *vals = NULL;                // values of the block being optimised
+int nvals = 0, valcap = 0;
+ValSlot *valtab = NULL;            // operator and constant values by hash
+int valtabcap = 0;
+Holder *holders = NULL;            // holder list entries
+int nholders = 0, holdercap = 0;
+OpndInfo *name_info = NULL, *temp_info = NULL;  // by name id and temporary number
+int name_info_cap = 0, temp_info_cap = 0;
+int *use_count = NULL;             // uses of each instruction's result (copy coalescing)
+int use_count_cap = 0;
+unsigned stamp = 0;                // current pass
+
+/* Information about operand x in the current pass */
+static OpndInfo *info(int x)
+{
+	OpndInfo *in;
+	if (IS_TEMP(x)) {
+		temp_info = grow(temp_info, &temp_info_cap, -x + 1, sizeof(OpndInfo));
+		in = &temp_info[-x];
 	} else {
-		/* For binary operators, emit a new temporary tN = left op right */
-		printf("t%d = %s %c %s\n", *temp_count, left, op, right);
-		/* push the temporary name onto operand stack as result of this op */
-		snprintf(opndstack[++opndstktop], VARLEN, "t%d", *temp_count);
-		(*temp_count)++; // increment temporary counter
+		name_info = grow(name_info, &name_info_cap, x + 1, sizeof(OpndInfo));
+		in = &name_info[x];
+	}
+	if (in->stamp != stamp) {       // first use in this pass
+		in->stamp = stamp;
+		in->val = -1;
+		in->live = !IS_TEMP(x);     // names are live at the end of the block
+		in->def_in = in->def_out = in->lastref = -1;
+	}
+	return in;
+}
+
+/* If operand x is a number, store it in k and return 1 */
+static int const_value(int x, long long *k)
+{
+	if (IS_TEMP(x))
+		return 0;
+	const char *s = names[x];
+	int i = s[0] == '-';            // folded constants may be negative
+	if (s[i] == '\0' || strlen(s + i) > 18)
+		return 0;                   // too long to fit in a long long
+	for (; s[i] != '\0'; i++)
+		if (!isdigit((unsigned char)s[i]))
+			return 0;
+	*k = strtoll(s, NULL, 10);
+	return 1;
+}
+
+/* Evaluate a op b into k, returns 0 if it can't be done at compile time */
+static int fold(char op, long long a, long long b, long long *k)
+{
+	switch (op) {
+	case '+': return !__builtin_add_overflow(a, b, k);
+	case '-': return !__builtin_sub_overflow(a, b, k);
+	case '*': return !__builtin_mul_overflow(a, b, k);
+	case '/':
+		if (b == 0 || (a == LLONG_MIN && b == -1))
+			return 0;               // leave the error for run time
+		*k = a / b;
+		return 1;
 	}
+	return 0;
 }
 
-/* Convert infix expression in global 'expn' into intermediate code,
-   using two stacks (operators and operands) and generating code via gen_op. */
+/* Append a new value */
+static int new_value(char op, int l, int r, long long k)
+{
+	vals = grow(vals, &valcap, nvals + 1, sizeof(Value));
+	vals[nvals] = (Value){op, l, r, k, -1};
+	return nvals++;
+}
+
+static unsigned value_hash(char op, int l, int r, long long k)
+{
+	unsigned h = 2166136261u;
+	h = (h ^ (unsigned char)op) * 16777619u;
+	h = (h ^ (unsigned)l) * 16777619u;
+	h = (h ^ (unsigned)r) * 16777619u;
+	h = (h ^ (unsigned)k) * 16777619u;
+	h = (h ^ (unsigned)(k >> 32)) * 16777619u;
+	return h ^ (h >> 15);           // the probes use the low bits, mix in the high ones
+}
+
+/* Return the value l op r, or the constant k if op is 'k', creating it if it
+   is new in the block */
+static int find_value(char op, int l, int r, long long k)
+{
+	if (2 * (nvals + 1) > valtabcap) {  // keep the table at most half full
+		free(valtab);
+		valtabcap = valtabcap ? valtabcap * 2 : 1024;
+		valtab = calloc(valtabcap, sizeof(ValSlot));
+		for (int v = 0; v < nvals; v++) {   // reinsert the hashed values
+			if (vals[v].op == 'l')
+				continue;
+			unsigned h = value_hash(vals[v].op, vals[v].l, vals[v].r, vals[v].k) & (valtabcap - 1);
+			while (valtab[h].stamp == stamp)
+				h = (h + 1) & (valtabcap - 1);
+			valtab[h] = (ValSlot){stamp, v};
+		}
+	}
+	unsigned h = value_hash(op, l, r, k) & (valtabcap - 1);
+	while (valtab[h].stamp == stamp) {
+		Value *v = &vals[valtab[h].val];
+		if (v->op == op && v->l == l && v->r == r && v->k == k)
+			return valtab[h].val;
+		h = (h + 1) & (valtabcap - 1);
+	}
+	valtab[h] = (ValSlot){stamp, nvals};
+	return new_value(op, l, r, k);
+}
+
+/* Record that operand x now holds value v. The first holder stays at the
+   head of the list, later ones are inserted after it. */
+static void add_holder(int v, int x)
+{
+	holders = grow(holders, &holdercap, nholders + 1, sizeof(Holder));
+	holders[nholders].opnd = x;
+	if (vals[v].holders < 0) {
+		holders[nholders].next = -1;
+		vals[v].holders = nholders;
+	} else {
+		holders[nholders].next = holders[vals[v].holders].next;
+		holders[vals[v].holders].next = nholders;
+	}
+	nholders++;
+}
+
+/* Oldest operand still holding value v, or NO_OPND. Entries for operands
+   that have since been assigned something else are unlinked on the way. */
+static int holder_of(int v)
+{
+	int *link = &vals[v].holders;
+	while (*link >= 0) {
+		int x = holders[*link].opnd;
+		if (info(x)->val == v)
+			return x;
+		*link = holders[*link].next;
+	}
+	return NO_OPND;
+}
+
+/* Current value of operand x, its value on entry if it wasn't assigned */
+static int value_of(int x)
+{
+	long long k;
+	if (info(x)->val < 0) {
+		int v = const_value(x, &k) ? find_value('k', 0, 0, k) : new_value('l', 0, 0, 0);
+		info(x)->val = v;
+		if (vals[v].op == 'l')
+			add_holder(v, x);
+	}
+	return info(x)->val;
+}
+
+/* Operand to use for value v */
+static int opnd_of(int v)
+{
+	if (vals[v].op == 'k') {
+		char buf[24];
+		int len = snprintf(buf, sizeof(buf), "%lld", vals[v].k);
+		return intern(buf, len);
+	}
+	int x = holder_of(v);
+	if (x == NO_OPND) {             // every value used has a holder, see number_values
+		fprintf(stderr, "Internal error: value %d is not held anywhere\n", v);
+		exit(1);
+	}
+	return x;
+}
+
+/* Value numbering pass over the n instructions at q, rewritten in place.
+   Returns the new number of instructions. */
+static int number_values(Quad *q, int n)
+{
+	int out = 0;
+	stamp++;
+	nvals = nholders = 0;
+	for (int i = 0; i < n; i++) {
+		Quad c = q[i];              // q[out] may overwrite q[i]
+		int v;
+		if (!DEFINES(c.op)) {       // labels and jumps stay, reading the current holders
+			if (NARGS(c.op) == 2) {
+				c.arg1 = opnd_of(value_of(c.arg1));
+				c.arg2 = opnd_of(value_of(c.arg2));
+			}
+			q[out++] = c;
+			continue;
+		}
+		if (c.op == '=')
+			v = value_of(c.arg1);
+		else {
+			int a = value_of(c.arg1), b = value_of(c.arg2);
+			long long k;
+			if (vals[a].op == 'k' && vals[b].op == 'k' && fold(c.op, vals[a].k, vals[b].k, &k))
+				v = find_value('k', 0, 0, k);
+			else {
+				int swap = (c.op == '+' || c.op == '*') && a > b; // commutative: one order for both
+				v = find_value(c.op, swap ? b : a, swap ? a : b, 0);
+				if (holder_of(v) == NO_OPND) {  // not computed yet, or overwritten since
+					q[out++] = (Quad){c.op, opnd_of(a), opnd_of(b), c.result};
+					info(c.result)->val = v;
+					add_holder(v, c.result);
+					continue;
+				}
+			}
+		}
+		if (value_of(c.result) == v)
+			continue;               // already holds the value
+		/* Copy the value. Later uses read the oldest holder instead, so the
+		   copy only survives dead code removal if the result is needed. */
+		q[out++] = (Quad){'=', opnd_of(v), NO_OPND, c.result};
+		info(c.result)->val = v;
+		if (vals[v].op != 'k')
+			add_holder(v, c.result);
+	}
+	return out;
+}
+
+/* Remove assignments whose result is not used later in the block. Names are
+   live at the end of the block, temporaries are not. */
+static int remove_dead(Quad *q, int n)
+{
+	int keep = n;
+	stamp++;
+	for (int i = n - 1; i >= 0; i--) {
+		Quad c = q[i];
+		if (DEFINES(c.op)) {
+			if (!info(c.result)->live)
+				continue;           // overwritten or never used: drop it
+			info(c.result)->live = 0;
+		}
+		if (NARGS(c.op) >= 1)
+			info(c.arg1)->live = 1;
+		if (NARGS(c.op) == 2)
+			info(c.arg2)->live = 1;
+		q[--keep] = c;
+	}
+	memmove(q, q + keep, (n - keep) * sizeof(Quad));
+	return n - keep;
+}
+
+/* Replace t = a op b ... x = t by x = a op b when that is the only use of t
+   and x isn't referenced in between */
+static int coalesce_copies(Quad *q, int n)
+{
+	int out = 0;
+	use_count = grow(use_count, &use_count_cap, n, sizeof(int));
+	stamp++;
+	for (int i = 0; i < n; i++) {   // count the uses of each definition
+		if (NARGS(q[i].op) >= 1 && IS_TEMP(q[i].arg1) && info(q[i].arg1)->def_in >= 0)
+			use_count[info(q[i].arg1)->def_in]++;
+		if (NARGS(q[i].op) == 2 && IS_TEMP(q[i].arg2) && info(q[i].arg2)->def_in >= 0)
+			use_count[info(q[i].arg2)->def_in]++;
+		use_count[i] = 0;
+		if (DEFINES(q[i].op))
+			info(q[i].result)->def_in = i;
+	}
+	stamp++;
+	for (int i = 0; i < n; i++) {
+		Quad c = q[i];
+		if (c.op == '=' && IS_TEMP(c.arg1) && c.arg1 != c.result) {
+			int d = info(c.arg1)->def_out;
+			if (d >= 0 && use_count[info(c.arg1)->def_in] == 1 && info(c.result)->lastref <= d) {
+				q[d].result = c.result; // compute straight into the copy's target
+				info(c.arg1)->def_out = -1;
+				info(c.result)->lastref = d;
+				continue;
+			}
+		}
+		if (NARGS(c.op) >= 1)
+			info(c.arg1)->lastref = out;
+		if (NARGS(c.op) == 2)
+			info(c.arg2)->lastref = out;
+		if (DEFINES(c.op)) {
+			info(c.result)->lastref = out;
+			info(c.result)->def_in = i;
+			info(c.result)->def_out = out;
+		}
+		q[out++] = c;
+	}
+	return out;
+}
+
+/* Optimise the basic block of n instructions at q in place, returns the new
+   number of instructions. A block may start with labels and end with a jump. */
+int optimise_block(Quad *q, int n)
+{
+	n = number_values(q, n);
+	n = remove_dead(q, n);
+	return coalesce_copies(q, n);
+}
+
+/* Append a generated block of about n instructions in the shape gen_op
+   produces, over a few names and small constants, for timing the optimiser */
+void generate_block(int n)
+{
+	static const char ops[] = "+-*/";
+	char buf[16];
+	unsigned seed = 12345;
+	int temp = 1;
+	while (ncode < n) {
+		int opnd[3];
+		for (int j = 0; j < 3; j++) {
+			seed = seed * 1103515245u + 12345u;
+			int r = (seed >> 16) % 24;
+			int len = r < 16 ? snprintf(buf, sizeof(buf), "v%d", r) : snprintf(buf, sizeof(buf), "%d", r - 15);
+			opnd[j] = intern(buf, len);
+		}
+		seed = seed * 1103515245u + 12345u;
+		emit(ops[(seed >> 16) % 4], opnd[0], opnd[1], TEMP(temp));
+		emit(ops[(seed >> 20) % 4], TEMP(temp), opnd[2], TEMP(temp + 1));
+		emit('=', TEMP(temp + 1), NO_OPND, intern(buf, snprintf(buf, sizeof(buf), "v%d", (seed >> 24) % 16)));
+		temp += 2;
+	}
+}
+
+static void scan_infix(void);
+
+/* Generate code for the operators left on the stack */
+static void flush_operators(void)
+{
+	/* flush remaining operators on the stack after processing input */
+	while (opstktop >= 0) {
+		if (opstack[opstktop] == '(' || opstack[opstktop] == ')') {
+			opstktop--; // ignore any stray parentheses
+			continue;
+		}
+		if (opndstktop < 1)
+			opstktop = -1;      // operator without operands, nothing to generate
+		else
+			gen_op(&temp_count); // generate code for remaining operators
+	}
+}
+
+/* Finish a statement: generate code for the operators left on the stack and
+   drop what remains of the operands */
+static void end_statement(void)
+{
+	if (opstktop < 0 && opndstktop < 0)
+		return;                 // empty statement
+	flush_operators();
+	while (opndstktop >= 0)
+		free_temp(opndstack[opndstktop--]); // value of an expression not assigned
+	nstatements++;
+}
+
+/* Convert the statements in global 'expn' into intermediate code, using two
+   stacks (operators and operands) and generating code via gen_op. Statements
+   end at a ';' or at the end of the line. */
 void icg_from_infix()
 {
-	int i = 0, temp_count = 1; // i = index into expn, temp_count = next temp number
+	scan_infix();
+	end_statement(); // the end of the line ends a statement
+}
+
+/* Run the two stack translation over global 'expn', ending statements at ';' */
+static void scan_infix(void)
+{
+	int i = 0; // i = index into expn
 	while (expn[i] != '\0') {   // iterate until end of string
 		/* skip spaces */
-		if (expn[i] == ' ') 
+		if (expn[i] == ' ' || expn[i] == '\t') 
 		{ 
 			i++; 
 			continue; 
 		} // ignore whitespace and advance
 
+		/* end of a statement */
+		if (expn[i] == ';') {
+			i++;
+			end_statement();
+			continue;
+		}
+
 		/* operand (identifier / number) */
 		if (isalnum((unsigned char)expn[i])) {
-			char tempopnd[VARLEN]; // buffer to collect the operand characters
-			int j = 0;
-			/* collect consecutive alphanumeric characters into tempopnd */
-			while (isalnum((unsigned char)expn[i]) && j < VARLEN-1)
-				tempopnd[j++] = expn[i++];
-			tempopnd[j] = '\0'; // null-terminate the operand string
-			/* push operand onto operand stack */
-			snprintf(opndstack[++opndstktop], VARLEN, "%s", tempopnd);
+			int start = i; // first character of the operand
+			/* skip over consecutive alphanumeric characters */
+			while (isalnum((unsigned char)expn[i]))
+				i++;
+			/* push the operand's id onto operand stack */
+			push_opnd(intern(expn + start, i - start));
 			continue; // processed an operand, go to next char
 		}
 
 		/* opening parenthesis */
 		if (expn[i] == '(') {
-			opstack[++opstktop] = expn[i++]; // push '(' onto operator stack and advance
+			push_op(expn[i++]); // push '(' onto operator stack and advance
 			continue;
 		}
 
@@ -97,26 +767,571 @@ void icg_from_infix()
 			   priority(opstack[opstktop]) >= priority(cur)) {
 			gen_op(&temp_count); // generate for the operator on top of stack
 		}
-		opstack[++opstktop] = cur; // push current operator onto operator stack
+		push_op(cur); // push current operator onto operator stack
 	}
+}
 
-	/* flush remaining operators on the stack after processing input */
-	while (opstktop >= 0) {
-		if (opstack[opstktop] == '(' || opstack[opstktop] == ')') {
-			opstktop--; // ignore any stray parentheses
+/* ---------------- Control flow ----------------
+   A program is a list of statements:
+       S -> id = E ;  |  if ( B ) S  |  if ( B ) S else S  |  while ( B ) S  |  { S... }
+       B -> B || B  |  B && B  |  ! B  |  ( B )  |  E relop E  |  E
+   It is translated in one pass. A condition leaves two lists of jumps whose
+   targets are not known yet, taken when it is true and when it is false, and
+   a statement leaves the list of jumps to whatever follows it. The lists are
+   backpatched once the target label is emitted. Expressions go through the
+   same two stack translation as single statements. */
+
+char *src = NULL;                  // Program being translated, cursor into it
+char *src_start = NULL;            // Start of the program, for error positions
+
+static const JumpList no_jumps = {-1, -1};
+
+/* A list holding the single jump at index i */
+static JumpList jump_list(int i)
+{
+	code[i].result = -1;
+	return (JumpList){i, i};
+}
+
+/* Concatenate two jump lists */
+static JumpList merge(JumpList a, JumpList b)
+{
+	if (a.head < 0)
+		return b;
+	if (b.head < 0)
+		return a;
+	code[a.tail].result = b.head;
+	return (JumpList){a.head, b.tail};
+}
+
+/* Emit a new label, returns its number */
+static int new_label(void)
+{
+	emit('L', NO_OPND, NO_OPND, nlabels);
+	return nlabels++;
+}
+
+/* Point every jump in list at label */
+static void backpatch(JumpList list, int label)
+{
+	for (int i = list.head; i >= 0; ) {
+		int next = code[i].result;
+		code[i].result = label;
+		i = next;
+	}
+}
+
+/* Point the jumps in list at the next instruction, if there are any */
+static void backpatch_here(JumpList list)
+{
+	if (list.head >= 0)
+		backpatch(list, new_label());
+}
+
+static void syntax_error(const char *expected)
+{
+	int line = 1;
+	for (char *p = src_start; p < src; p++)
+		line += *p == '\n';
+	fprintf(stderr, "Syntax error on line %d: expected %s\n", line, expected);
+	exit(1);
+}
+
+/* Skip blanks, line breaks and // comments */
+static void skip_space(void)
+{
+	while (1) {
+		while (isspace((unsigned char)*src))
+			src++;
+		if (src[0] != '/' || src[1] != '/')
+			return;
+		while (*src != '\0' && *src != '\n')
+			src++;
+	}
+}
+
+/* Consume keyword kw if it comes next */
+static int keyword(const char *kw)
+{
+	int len = strlen(kw);
+	skip_space();
+	if (strncmp(src, kw, len) != 0 || isalnum((unsigned char)src[len]) || src[len] == '_')
+		return 0;
+	src += len;
+	return 1;
+}
+
+static void expect(char c)
+{
+	skip_space();
+	if (*src != c) {
+		char what[4] = {'\'', c, '\'', '\0'};
+		syntax_error(what);
+	}
+	src++;
+}
+
+/* Translate the expression from s up to end, returns the operand holding its value */
+static int expr_value(char *s, char *end)
+{
+	char save = *end;
+	*end = '\0';
+	expn = s;
+	scan_infix();
+	flush_operators();
+	*end = save;
+	if (opndstktop != 0)
+		syntax_error("an expression");
+	return opndstack[opndstktop--];
+}
+
+/* End of the arithmetic expression starting at p: the first relational or
+   logical operator, or unmatched ')', outside parentheses */
+static char *expr_end(char *p)
+{
+	int depth = 0;
+	for (; *p != '\0'; p++) {
+		if (*p == '(')
+			depth++;
+		else if (*p == ')' && depth-- == 0)
+			break;
+		else if (depth == 0 && (strchr("<>!=|", *p) || (*p == '&' && p[1] == '&')))
+			break;
+	}
+	return p;
+}
+
+/* Does the parenthesis at p enclose a condition rather than an expression?
+   It does if a relational or logical operator appears anywhere inside it,
+   however deeply nested, since an expression can't contain one. */
+static int is_condition_group(char *p)
+{
+	int depth = 0;
+	for (; *p != '\0'; p++) {
+		if (*p == '(')
+			depth++;
+		else if (*p == ')' && --depth == 0)
+			return 0;
+		else if (strchr("<>!=|&", *p))
+			return 1;
+	}
+	return 0;
+}
+
+static void condition(JumpList *t, JumpList *f);
+
+/* B -> ! B | ( B ) | E relop E | E */
+static void condition_factor(JumpList *t, JumpList *f)
+{
+	skip_space();
+	if (src[0] == '!' && src[1] != '=') {
+		src++;
+		condition_factor(f, t);     // not B swaps the true and false exits
+		return;
+	}
+	if (src[0] == '(' && is_condition_group(src)) {
+		src++;
+		condition(t, f);
+		expect(')');
+		return;
+	}
+	char *end = expr_end(src);
+	if (end == src)
+		syntax_error("an expression");
+	int left = expr_value(src, end), right;
+	char rel;
+	src = end;
+	skip_space();
+	if (strncmp(src, "<=", 2) == 0) rel = 'l';
+	else if (strncmp(src, ">=", 2) == 0) rel = 'g';
+	else if (strncmp(src, "==", 2) == 0) rel = 'e';
+	else if (strncmp(src, "!=", 2) == 0) rel = 'n';
+	else if (*src == '<' || *src == '>') rel = *src;
+	else rel = 0;
+	if (rel != 0) {
+		src += rel == '<' || rel == '>' ? 1 : 2;
+		skip_space();
+		end = expr_end(src);
+		if (end == src)
+			syntax_error("an expression");
+		right = expr_value(src, end);
+		src = end;
+	} else {                        // a plain expression is true when not zero
+		rel = 'n';
+		right = intern("0", 1);
+	}
+	*t = jump_list(emit(rel, left, right, -1));
+	*f = jump_list(emit('j', NO_OPND, NO_OPND, -1));
+	free_temp(right);
+	free_temp(left);
+}
+
+/* B -> B && B */
+static void condition_term(JumpList *t, JumpList *f)
+{
+	condition_factor(t, f);
+	while (skip_space(), src[0] == '&' && src[1] == '&') {
+		JumpList t2, f2;
+		src += 2;
+		backpatch_here(*t);         // the right operand runs when the left is true
+		condition_factor(&t2, &f2);
+		*t = t2;
+		*f = merge(*f, f2);
+	}
+}
+
+/* B -> B || B */
+static void condition(JumpList *t, JumpList *f)
+{
+	condition_term(t, f);
+	while (skip_space(), src[0] == '|' && src[1] == '|') {
+		JumpList t2, f2;
+		src += 2;
+		backpatch_here(*f);         // the right operand runs when the left is false
+		condition_term(&t2, &f2);
+		*t = merge(*t, t2);
+		*f = f2;
+	}
+}
+
+static JumpList statement(void);
+
+/* Statements up to a '}' or the end of the program; returns the jumps out of the last one */
+static JumpList statement_list(void)
+{
+	JumpList next = no_jumps;
+	while (skip_space(), *src != '\0' && *src != '}') {
+		backpatch_here(next);       // the previous statement continues here
+		next = statement();
+	}
+	return next;
+}
+
+/* Translate one statement, returns the jumps to the statement after it */
+static JumpList statement(void)
+{
+	JumpList t, f, next;
+	skip_space();
+	if (keyword("if")) {
+		expect('(');
+		condition(&t, &f);
+		expect(')');
+		backpatch_here(t);
+		next = statement();
+		if (keyword("else")) {
+			/* jump over the else part at the end of the then part */
+			next = merge(next, jump_list(emit('j', NO_OPND, NO_OPND, -1)));
+			backpatch_here(f);
+			return merge(next, statement());
+		}
+		return merge(next, f);
+	}
+	if (keyword("while")) {
+		int top = new_label();
+		expect('(');
+		condition(&t, &f);
+		expect(')');
+		backpatch_here(t);
+		backpatch(statement(), top);
+		emit('j', NO_OPND, NO_OPND, top);
+		return f;
+	}
+	if (*src == '{') {
+		src++;
+		next = statement_list();
+		expect('}');
+		return next;
+	}
+	char *end = src + strcspn(src, ";}");
+	if (*end != ';')
+		syntax_error("';'");
+	char save = *end;
+	*end = '\0';
+	expn = src;
+	icg_from_infix();
+	*end = save;
+	src = end + 1;
+	return no_jumps;
+}
+
+/* Translate the program in text */
+void icg_program(char *text)
+{
+	src = src_start = text;
+	JumpList next = statement_list();
+	if (*src != '\0')
+		syntax_error("a statement");
+	backpatch_here(next);           // the last statement falls off the end
+}
+
+/* Split the code into basic blocks and build the control flow graph.
+   Leaders are the first instruction, labels not preceded by another label
+   and instructions after jumps. */
+void build_cfg(void)
+{
+	nblocks = 0;
+	label_block = grow(label_block, &label_block_cap, nlabels, sizeof(int));
+	for (int i = 0; i < ncode; i++) {
+		if (i == 0 || (code[i].op == 'L' && code[i - 1].op != 'L') || IS_JUMP(code[i - 1].op)) {
+			blocks = grow(blocks, &blockcap, nblocks + 1, sizeof(Block));
+			if (nblocks > 0)
+				blocks[nblocks - 1].end = i;
+			blocks[nblocks++].start = i;
+		}
+		if (code[i].op == 'L')
+			label_block[code[i].result] = nblocks - 1;
+	}
+	if (nblocks > 0)
+		blocks[nblocks - 1].end = ncode;
+
+	/* successors: the jump target and falling through to the next block */
+	succ_start = grow(succ_start, &succ_start_cap, nblocks + 1, sizeof(int));
+	succs = grow(succs, &succcap, 2 * nblocks, sizeof(int));
+	pred_start = grow(pred_start, &pred_start_cap, nblocks + 1, sizeof(int));
+	memset(pred_start, 0, (nblocks + 1) * sizeof(int));
+	int nedges = 0;
+	for (int b = 0; b < nblocks; b++) {
+		Quad *last = &code[blocks[b].end - 1];
+		succ_start[b] = nedges;
+		if (IS_JUMP(last->op))
+			succs[nedges++] = label_block[last->result];
+		if (last->op != 'j' && b + 1 < nblocks)
+			succs[nedges++] = b + 1;
+		for (int e = succ_start[b]; e < nedges; e++)
+			pred_start[succs[e] + 1]++;
+	}
+	succ_start[nblocks] = nedges;
+
+	/* predecessors: the same edges reversed, placed by counting sort */
+	for (int b = 0; b < nblocks; b++)
+		pred_start[b + 1] += pred_start[b];
+	preds = grow(preds, &predcap, nedges, sizeof(int));
+	int *fill = malloc((nblocks + 1) * sizeof(int));
+	memcpy(fill, pred_start, (nblocks + 1) * sizeof(int));
+	for (int b = 0; b < nblocks; b++)
+		for (int e = succ_start[b]; e < succ_start[b + 1]; e++)
+			preds[fill[succs[e]]++] = b;
+	free(fill);
+}
+
+/* Optimise every basic block on its own, then rebuild the graph */
+void optimise_blocks(void)
+{
+	int out = 0;
+	build_cfg();
+	for (int b = 0; b < nblocks; b++) {
+		int start = blocks[b].start, n = blocks[b].end - start;
+		n = optimise_block(code + start, n);
+		memmove(code + out, code + start, n * sizeof(Quad));
+		out += n;
+	}
+	ncode = out;
+	build_cfg();
+}
+
+/* Print the basic blocks with their successors and predecessors */
+void print_cfg(FILE *out)
+{
+	for (int b = 0; b < nblocks; b++) {
+		fprintf(out, "B%d: instructions %d-%d, successors", b, blocks[b].start, blocks[b].end - 1);
+		for (int e = succ_start[b]; e < succ_start[b + 1]; e++)
+			fprintf(out, " B%d", succs[e]);
+		fprintf(out, ", predecessors");
+		for (int e = pred_start[b]; e < pred_start[b + 1]; e++)
+			fprintf(out, " B%d", preds[e]);
+		fprintf(out, "\n");
+	}
+}
+
+/* Translate every line read from in, optimising and printing the code in
+   batches of about BATCH instructions so memory use stays bounded. Prints the
+   totals and the translation rate to stderr. */
+void translate_stream(FILE *in, int quiet, int optimise)
+{
+	long before = 0, after = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (getline(&expn, &expncap, in) > 0) {
+		expn[strcspn(expn, "\r\n")] = '\0';
+		icg_from_infix();
+		if (ncode < BATCH)
 			continue;
+		/* statements never leave temporaries live, so a batch boundary is
+		   a valid end of a block */
+		before += ncode;
+		if (optimise)
+			ncode = optimise_block(code, ncode);
+		after += ncode;
+		if (!quiet)
+			print_code(stdout);
+		ncode = 0;
+	}
+	before += ncode;
+	if (optimise)
+		ncode = optimise_block(code, ncode);
+	after += ncode;
+	if (!quiet)
+		print_code(stdout);
+	ncode = 0;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "%ld statements, %ld instructions", nstatements, before);
+	if (optimise)
+		fprintf(stderr, " (%ld after optimisation)", after);
+	fprintf(stderr, ", %d symbols, %d temporaries\n", nnames, maxtemps);
+	fprintf(stderr, "%.3f s, %.0f statements/sec\n", secs, secs > 0 ? nstatements / secs : 0);
+}
+
+/* Read all of in into a null terminated buffer */
+static char *read_all(FILE *in)
+{
+	char *text = NULL;
+	int len = 0, cap = 0;
+	size_t got;
+	do {
+		text = grow(text, &cap, len + 65536 + 1, 1);
+		got = fread(text + len, 1, cap - len - 1, in);
+		len += got;
+	} while (got > 0);
+	text[len] = '\0';
+	return text;
+}
+
+/* Programs with conditions in extra parentheses, each paired with the same
+   program without them */
+static const char *paren_tests[][2] = {
+	{"if (((a <= b))) x = 1;", "if (a <= b) x = 1;"},
+	{"if (k < 4 && ((a <= b))) x = 1;", "if (k < 4 && a <= b) x = 1;"},
+	{"while (k1 < 3 && ((b > d))) k1 = k1 + 1;", "while (k1 < 3 && b > d) k1 = k1 + 1;"},
+	{"if (!((a < b) || ((c == d)))) x = 1; else x = 2;", "if (!(a < b || c == d)) x = 1; else x = 2;"},
+	{"if (((a + b) * c >= (d))) x = 1;", "if ((a + b) * c >= d) x = 1;"},
+};
+
+/* Check that each pair translates to the same code, with every jump
+   backpatched to a label. Returns the number of pairs that fail. */
+int self_test(void)
+{
+	int failures = 0;
+	for (int i = 0; i < (int)(sizeof(paren_tests) / sizeof(paren_tests[0])); i++) {
+		Quad *first = NULL;
+		int nfirst = 0, bad = 0;
+		for (int k = 0; k < 2; k++) {
+			char *text = strdup(paren_tests[i][k]);
+			ncode = nlabels = nfreetemps = 0;
+			temp_count = 1;
+			opstktop = opndstktop = -1;
+			icg_program(text);
+			free(text);
+			for (int j = 0; j < ncode; j++)
+				if (IS_JUMP(code[j].op) && (code[j].result < 0 || code[j].result >= nlabels))
+					bad = 1;       // a jump never backpatched
+			if (k == 0) {
+				nfirst = ncode;
+				first = malloc((ncode + 1) * sizeof(Quad));
+				memcpy(first, code, ncode * sizeof(Quad));
+				continue;
+			}
+			bad |= ncode != nfirst;
+			for (int j = 0; j < ncode && j < nfirst; j++)
+				bad |= code[j].op != first[j].op || code[j].arg1 != first[j].arg1
+					|| code[j].arg2 != first[j].arg2 || code[j].result != first[j].result;
 		}
-		gen_op(&temp_count); // generate code for remaining operators
+		free(first);
+		printf("%-50s %s\n", paren_tests[i][0], bad ? "FAILED" : "ok");
+		failures += bad;
 	}
+	return failures;
 }
 
-int main()
+/* Usage: ./a.out [-q] [-O] [-g n] [-s [file]] [-p [file]] [-b] [-t]
+     -q  build the code without printing it
+     -O  optimise the code and report the instruction counts
+     -g  optimise a generated block of n instructions instead of reading one
+     -s  translate all the statements in file (or stdin), one or more per line
+     -p  translate the program in file (or stdin), with if, while and { }
+     -b  with -p, print the basic blocks and the control flow graph
+     -t  check the translation of conditions in extra parentheses */
+int main(int argc, char *argv[])
 {
-	printf("Enter an expression (spaces allowed, e.g. a=b+c*(d+e)):\n"); // prompt
-	if (!fgets(expn, sizeof(expn), stdin)) return 0; // read line into expn; exit on EOF/error
-	/* trim newline characters from the input (both CR and LF) */
-	expn[strcspn(expn, "\r\n")] = '\0';
+	int quiet = 0, optimise = 0, generate = 0, stream = 0, program = 0, show_cfg = 0;
+	const char *file = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-q") == 0)
+			quiet = 1;
+		else if (strcmp(argv[i], "-O") == 0)
+			optimise = 1;
+		else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+			generate = atoi(argv[++i]), optimise = 1;
+		else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "-p") == 0) {
+			stream = argv[i][1] == 's';
+			program = argv[i][1] == 'p';
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				file = argv[++i];
+		} else if (strcmp(argv[i], "-b") == 0)
+			show_cfg = 1;
+		else if (strcmp(argv[i], "-t") == 0)
+			return self_test() > 0;
+		else {
+			fprintf(stderr, "Usage: %s [-q] [-O] [-g n] [-s [file]] [-p [file]] [-b] [-t]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (program) {
+		FILE *in = file ? fopen(file, "r") : stdin;
+		if (in == NULL) {
+			perror(file);
+			return 1;
+		}
+		icg_program(read_all(in));
+		int before = ncode;
+		if (optimise)
+			optimise_blocks();
+		else
+			build_cfg();
+		if (!quiet)
+			print_code(stdout);
+		if (show_cfg)
+			print_cfg(stdout);
+		printf("%ld statements, %d instructions, %d basic blocks", nstatements, ncode, nblocks);
+		if (optimise)
+			printf(", %d instructions before optimisation", before);
+		printf("\n");
+		return 0;
+	}
+	if (stream) {
+		FILE *in = file ? fopen(file, "r") : stdin;
+		if (in == NULL) {
+			perror(file);
+			return 1;
+		}
+		translate_stream(in, quiet, optimise);
+		return 0;
+	}
+	if (generate > 0)
+		generate_block(generate); // a large block for timing the optimiser
+	else {
+		printf("Enter an expression (spaces allowed, e.g. a=b+c*(d+e)):\n"); // prompt
+		fflush(stdout);
+		if (getline(&expn, &expncap, stdin) <= 0) return 0; // read line into expn; exit on EOF/error
+		/* trim newline characters from the input (both CR and LF) */
+		expn[strcspn(expn, "\r\n")] = '\0';
 
-	icg_from_infix(); // perform intermediate code generation and print the results
+		icg_from_infix(); // perform intermediate code generation into code[]
+	}
+	int before = ncode;
+	double ms = 0;
+	if (optimise) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ncode = optimise_block(code, ncode); // the code has no jumps, it is one block
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+	}
+	if (!quiet)
+		print_code(stdout); // print the results as text
+	else
+		printf("%d instructions, %d symbols, %d temporaries\n", ncode, nnames, maxtemps);
+	if (optimise)
+		printf("Instructions before optimisation: %d, after: %d (%.2f ms)\n", before, ncode, ms);
 	return 0; // normal termination
 }
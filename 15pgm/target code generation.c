@@ -1,50 +1,1599 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
-#define LEN 5
-#define SIZE 50
+#define NUMREGS 4
+#define NONE -1          // next use of a dead variable
+#define END INT_MAX      // next use of a variable live at the end of the block
+#define BATCH 65536      // instructions read and translated as one block
+#define CHUNK 65536      // bytes read from the input at a time
+#define NAME_CHUNK 65536 // bytes of names stored together
 
 struct
 {
-	char res[LEN];
-	char op;
-	char opnd1[LEN];
-	char opnd2[LEN];
-} tac[SIZE];
+	char *res;           // interned names, opnd2 is "" for a copy
+	char op;             // '+', '-', '*', '/', or '=' for a copy res = opnd1
+	char *opnd1;
+	char *opnd2;
+	int res_id, opnd1_id, opnd2_id;       // variable ids, -1 for constants
+	int res_next, opnd1_next, opnd2_next; // next use after this instruction
+	int res_iv, opnd1_iv, opnd2_iv;       // live intervals, -1 for constants
+} *tac = NULL;
 
-int num_instr = 0;
-char instr[SIZE];
+int num_instr = 0, tac_cap = 0;
+int num_lookahead = 0;           // instructions read after the block, at tac[num_instr]
+int more_input = 0;              // more instructions follow the lookahead
 
-void readThreeAddressCode()
+// Names of the instructions of one batch, each stored once. The storage is
+// kept in chunks that never move, and reused for a later batch.
+typedef struct
 {
-	printf("Enter the number of three address instructions: ");
-	scanf("%d", &num_instr);
+	char **chunks;
+	size_t *sizes;
+	int num_chunks, chunk;       // chunk being filled
+	size_t used;                 // bytes used in it
+	char **hash;                 // open addressing
+	int hash_cap, count;
+} Names;
 
-	printf("Enter each instruction, seperate result opcodes and operands by space\n");
-	printf("Eg. s = a + b\n");
+Names names[2];                  // the block and the lookahead
 
-	for(int i = 0; i < num_instr; i++)
-		scanf("%s = %s %c %s", tac[i].res, tac[i].opnd1, &tac[i].op, tac[i].opnd2);
+// Input, read in chunks. Lines may be of any length.
+FILE *in;
+char *inbuf = NULL;
+size_t in_len = 0, in_pos = 0, in_cap = 0;
+int in_eof = 0, interactive = 0;
+long line_no = 0;
+
+// Output buffer
+char outbuf[1 << 16];
+int outlen = 0;
+
+// Variables of the block. A variable's address descriptor says whether memory
+// holds its current value and which registers do; a register's descriptor is
+// the set of variables whose value it holds.
+char *regname[NUMREGS] = {"AX", "BX", "CX", "DX"};
+char **vars = NULL;
+int num_vars = 0, vars_cap = 0;
+int *var_hash = NULL, hash_cap = 0;  // open addressing, variable id + 1
+int *in_mem = NULL;              // memory copy is up to date
+int *in_reg = NULL;              // bit r set if register r holds the variable
+int *next_use = NULL;            // next use as of the instruction being translated
+int *live_out = NULL;            // live at the end of the block
+int *reg_vars[NUMREGS];          // register descriptors
+int num_reg_vars[NUMREGS];
+
+// Emitted code, kept as a list so the peephole optimiser can rewrite it
+typedef struct
+{
+	const char *op;
+	const char *dst;
+	const char *src;
+} AsmInstr;
+
+AsmInstr *code = NULL;
+int num_code = 0, code_cap = 0;
+
+// What the peephole optimiser did
+int removed_moves = 0, removed_stores = 0, removed_loads = 0, removed_identities = 0, num_reductions = 0;
+
+// Constants are used as immediate operands, everything else is a variable
+int is_const(const char *name)
+{
+	return isdigit((unsigned char)name[0]);
 }
 
-char *get_instr(char op)
+// Temporaries t1, t2, ... are dead at the end of the input, other variables are live
+int is_temp(const char *name)
+{
+	if(name[0] != 't' || !name[1])
+		return 0;
+	for(const char *p = name + 1; *p; p++)
+		if(!isdigit((unsigned char)*p))
+			return 0;
+	return 1;
+}
+
+// Mnemonic of an arithmetic operator, NULL for anything else
+const char *get_instr(char op)
 {
 	// ASCII values are * = 42,  + = 43, - = 45, / = 47
-	char mnemonics[][LEN] = {"MUL", "ADD", "", "SUB", "", "DIV"};
-	strcpy(instr, mnemonics[op - '*']);
-	return instr;
+	static const char *mnemonics[] = {"MUL", "ADD", NULL, "SUB", NULL, "DIV"};
+	if(op < '*' || op > '/')
+		return NULL;
+	return mnemonics[op - '*'];
+}
+
+// FNV-1a of len characters
+unsigned hash_chars(const char *s, size_t len)
+{
+	unsigned h = 2166136261u;
+	while(len--)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+// The stored copy of the len characters at s
+char *intern(Names *t, const char *s, size_t len)
+{
+	if(2 * (t->count + 1) > t->hash_cap)
+	{
+		// keep the table at most half full
+		char **old = t->hash;
+		int old_cap = t->hash_cap;
+		t->hash_cap = old_cap ? 2 * old_cap : 1024;
+		t->hash = calloc(t->hash_cap, sizeof(char *));
+		for(int k = 0; k < old_cap; k++)
+			if(old[k])
+			{
+				int i = hash_chars(old[k], strlen(old[k])) & (t->hash_cap - 1);
+				while(t->hash[i])
+					i = (i + 1) & (t->hash_cap - 1);
+				t->hash[i] = old[k];
+			}
+		free(old);
+	}
+	int i = hash_chars(s, len) & (t->hash_cap - 1);
+	while(t->hash[i])
+	{
+		if(strncmp(t->hash[i], s, len) == 0 && t->hash[i][len] == '\0')
+			return t->hash[i];
+		i = (i + 1) & (t->hash_cap - 1);
+	}
+
+	// store it in the first chunk with room, a new one if none has
+	while(t->chunk < t->num_chunks && t->used + len + 1 > t->sizes[t->chunk])
+	{
+		t->chunk++;
+		t->used = 0;
+	}
+	if(t->chunk == t->num_chunks)
+	{
+		t->chunks = realloc(t->chunks, (t->num_chunks + 1) * sizeof(char *));
+		t->sizes = realloc(t->sizes, (t->num_chunks + 1) * sizeof(size_t));
+		t->sizes[t->num_chunks] = len + 1 > NAME_CHUNK ? len + 1 : NAME_CHUNK;
+		t->chunks[t->num_chunks++] = malloc(t->sizes[t->chunk]);
+		t->used = 0;
+	}
+	char *copy = t->chunks[t->chunk] + t->used;
+	memcpy(copy, s, len);
+	copy[len] = '\0';
+	t->used += len + 1;
+	t->count++;
+	return t->hash[i] = copy;
+}
+
+// Forget the names, keeping the storage
+void clear_names(Names *t)
+{
+	if(t->hash_cap)
+		memset(t->hash, 0, t->hash_cap * sizeof(char *));
+	t->count = 0;
+	t->chunk = 0;
+	t->used = 0;
+}
+
+// Room for instruction n
+void grow_tac(int n)
+{
+	if(n >= tac_cap)
+	{
+		tac_cap = tac_cap ? 2 * tac_cap : 64;
+		while(tac_cap <= n)
+			tac_cap *= 2;
+		tac = realloc(tac, tac_cap * sizeof(*tac));
+	}
+}
+
+// The next line of the input without its newline, or NULL at the end. From a
+// terminal lines are read one at a time, otherwise a chunk at a time.
+char *next_line()
+{
+	for(;;)
+	{
+		char *nl = memchr(inbuf + in_pos, '\n', in_len - in_pos);
+		if(nl || (in_eof && in_pos < in_len))
+		{
+			char *line = inbuf + in_pos;
+			if(!nl)
+				nl = inbuf + in_len;     // the last line has no newline
+			*nl = '\0';
+			in_pos = nl - inbuf + 1;
+			if(in_pos > in_len)
+				in_pos = in_len;
+			line_no++;
+			return line;
+		}
+		if(in_eof)
+			return NULL;
+
+		// keep the start of the line and read more
+		memmove(inbuf, inbuf + in_pos, in_len - in_pos);
+		in_len -= in_pos;
+		in_pos = 0;
+		if(in_cap < in_len + CHUNK + 1)
+		{
+			in_cap = in_cap ? 2 * in_cap : CHUNK + 1;
+			while(in_cap < in_len + CHUNK + 1)
+				in_cap *= 2;
+			inbuf = realloc(inbuf, in_cap);
+		}
+		size_t got;
+		if(interactive)
+			got = fgets(inbuf + in_len, CHUNK + 1, in) ? strlen(inbuf + in_len) : 0;
+		else
+			got = fread(inbuf + in_len, 1, CHUNK, in);
+		in_len += got;
+		if(got == 0)
+			in_eof = 1;
+	}
 }
 
+// Read instructions "x = y op z" and copies "x = y" into tac[first] onwards,
+// at most max of them, naming their operands in t. Returns how many were read.
+// Malformed lines are reported and skipped. From a terminal an empty line ends
+// the input.
+int read_instructions(Names *t, int first, int max)
+{
+	int n = 0;
+	char *line;
+	while(n < max && (line = next_line()) != NULL)
+	{
+		char *tok[6];
+		size_t len[6];
+		int num_tok = 0;
+		for(char *c = line; *c && num_tok < 6;)
+		{
+			while(isspace((unsigned char)*c))
+				c++;
+			if(!*c)
+				break;
+			tok[num_tok] = c;
+			while(*c && !isspace((unsigned char)*c))
+				c++;
+			len[num_tok] = c - tok[num_tok];
+			num_tok++;
+		}
+		if(num_tok == 0)
+		{
+			if(interactive)
+			{
+				in_eof = 1;
+				in_pos = in_len;
+			}
+			continue;
+		}
+		if((num_tok != 3 && num_tok != 5) || len[1] != 1 || tok[1][0] != '=' || is_const(tok[0]) ||
+		   (num_tok == 5 && (len[3] != 1 || !get_instr(tok[3][0]))))
+		{
+			fprintf(stderr, "line %ld: expected x = y op z or x = y, with op one of + - * /\n", line_no);
+			continue;
+		}
+		grow_tac(first + n);
+		tac[first + n].res = intern(t, tok[0], len[0]);
+		tac[first + n].opnd1 = intern(t, tok[2], len[2]);
+		tac[first + n].op = num_tok == 5 ? tok[3][0] : '=';
+		tac[first + n].opnd2 = num_tok == 5 ? intern(t, tok[4], len[4]) : "";
+		n++;
+	}
+	return n;
+}
+
+// A memory operand is a variable, as opposed to a register or an immediate
+int is_mem(const char *opnd)
+{
+	if(opnd[0] == '\0' || isdigit((unsigned char)opnd[0]))
+		return 0;
+	for(int r = 0; r < NUMREGS; r++)
+		if(strcmp(opnd, regname[r]) == 0)
+			return 0;
+	return 1;
+}
+
+// Append one instruction to the code
+void emit(const char *op, const char *dst, const char *src)
+{
+	if(num_code == code_cap)
+	{
+		code_cap = code_cap ? 2 * code_cap : 256;
+		code = realloc(code, code_cap * sizeof(AsmInstr));
+	}
+	code[num_code].op = op;
+	code[num_code].dst = dst;
+	code[num_code].src = src;
+	num_code++;
+}
+
+void out_flush()
+{
+	fwrite(outbuf, 1, outlen, stdout);
+	outlen = 0;
+}
+
+void out_str(const char *s)
+{
+	int len = strlen(s);
+	if(outlen + len > (int)sizeof(outbuf))
+	{
+		out_flush();
+		if(len > (int)sizeof(outbuf))
+		{
+			fwrite(s, 1, len, stdout);   // too long to buffer
+			return;
+		}
+	}
+	memcpy(outbuf + outlen, s, len);
+	outlen += len;
+}
+
+void print_code()
+{
+	for(int i = 0; i < num_code; i++)
+	{
+		out_str(code[i].op);
+		out_str(" ");
+		out_str(code[i].dst);
+		out_str(", ");
+		out_str(code[i].src);
+		out_str("\n");
+	}
+}
+
+// Number of instructions in the code and how many of them access memory
+void count_code(int *instrs, int *mem_ops)
+{
+	*instrs = num_code;
+	*mem_ops = 0;
+	for(int i = 0; i < num_code; i++)
+		*mem_ops += is_mem(code[i].dst) || is_mem(code[i].src);
+}
+
+// Slot of the hash table holding name, or the empty slot where it goes
+int hash_slot(const char *name)
+{
+	int i = hash_chars(name, strlen(name)) & (hash_cap - 1);
+	while(var_hash[i] && strcmp(vars[var_hash[i] - 1], name) != 0)
+		i = (i + 1) & (hash_cap - 1);
+	return i;
+}
+
+// Id of a variable already numbered, or -1
+int find_var(const char *name)
+{
+	if(hash_cap == 0)
+		return -1;
+	return var_hash[hash_slot(name)] - 1;
+}
+
+int var_id(char *name)
+{
+	if(is_const(name))
+		return -1;
+	if(2 * (num_vars + 1) > hash_cap)
+	{
+		// keep the table at most half full
+		hash_cap = hash_cap ? 2 * hash_cap : 256;
+		var_hash = realloc(var_hash, hash_cap * sizeof(int));
+		memset(var_hash, 0, hash_cap * sizeof(int));
+		for(int v = 0; v < num_vars; v++)
+			var_hash[hash_slot(vars[v])] = v + 1;
+	}
+	int slot = hash_slot(name);
+	if(var_hash[slot])
+		return var_hash[slot] - 1;
+	if(num_vars == vars_cap)
+	{
+		vars_cap = vars_cap ? 2 * vars_cap : 64;
+		vars = realloc(vars, vars_cap * sizeof(*vars));
+	}
+	vars[num_vars] = name;
+	var_hash[slot] = num_vars + 1;
+	return num_vars++;
+}
+
+// Which variables of the block are live at its end: all but the temporaries,
+// and the temporaries the lookahead reads before writing them. A temporary the
+// lookahead doesn't mention is assumed live unless the input ends there.
+void compute_live_out()
+{
+	live_out = realloc(live_out, (num_vars + 1) * sizeof(int));
+	for(int v = 0; v < num_vars; v++)
+		live_out[v] = is_temp(vars[v]) ? -1 : 1;
+	for(int i = num_instr; i < num_instr + num_lookahead; i++)
+	{
+		int y = find_var(tac[i].opnd1), z = find_var(tac[i].opnd2), x = find_var(tac[i].res);
+		if(y >= 0 && live_out[y] < 0)
+			live_out[y] = 1;
+		if(z >= 0 && live_out[z] < 0)
+			live_out[z] = 1;
+		if(x >= 0 && live_out[x] < 0)
+			live_out[x] = 0;
+	}
+	for(int v = 0; v < num_vars; v++)
+		if(live_out[v] < 0)
+			live_out[v] = more_input;
+}
+
+// Number the variables and attach next use information to every instruction,
+// scanning the block backwards
+void compute_next_uses()
+{
+	num_vars = 0;
+	if(hash_cap)
+		memset(var_hash, 0, hash_cap * sizeof(int));
+	for(int i = 0; i < num_instr; i++)
+	{
+		tac[i].res_id = var_id(tac[i].res);
+		tac[i].opnd1_id = var_id(tac[i].opnd1);
+		tac[i].opnd2_id = tac[i].op == '=' ? -1 : var_id(tac[i].opnd2);
+	}
+	int *state = malloc((num_vars + 1) * sizeof(int));
+	compute_live_out();
+	for(int v = 0; v < num_vars; v++)
+		state[v] = live_out[v] ? END : NONE;
+	for(int i = num_instr - 1; i >= 0; i--)
+	{
+		int x = tac[i].res_id, y = tac[i].opnd1_id, z = tac[i].opnd2_id;
+		tac[i].res_next = state[x];
+		tac[i].opnd1_next = y >= 0 ? state[y] : NONE;
+		tac[i].opnd2_next = z >= 0 ? state[z] : NONE;
+		state[x] = NONE;
+		if(y >= 0)
+			state[y] = i;
+		if(z >= 0)
+			state[z] = i;
+	}
+	free(state);
+
+	// per variable state of the translations
+	in_mem = realloc(in_mem, (num_vars + 1) * sizeof(int));
+	in_reg = realloc(in_reg, (num_vars + 1) * sizeof(int));
+	next_use = realloc(next_use, (num_vars + 1) * sizeof(int));
+	for(int r = 0; r < NUMREGS; r++)
+		reg_vars[r] = realloc(reg_vars[r], (num_vars + 1) * sizeof(int));
+}
+
+void add_to_reg(int r, int v)
+{
+	if(!(in_reg[v] & 1 << r))
+		reg_vars[r][num_reg_vars[r]++] = v;
+	in_reg[v] |= 1 << r;
+}
+
+// Register r no longer holds variable v
+void remove_from_reg(int r, int v)
+{
+	in_reg[v] &= ~(1 << r);
+	for(int k = 0; k < num_reg_vars[r]; k++)
+		if(reg_vars[r][k] == v)
+		{
+			reg_vars[r][k] = reg_vars[r][--num_reg_vars[r]];
+			return;
+		}
+}
+
+// Register r is the only place holding the value of v, and it is still needed
+int only_in(int r, int v, int x)
+{
+	return v != x && next_use[v] != NONE && !in_mem[v] && in_reg[v] == 1 << r;
+}
+
+// Stores needed before register r can be overwritten by the result x
+int spill_cost(int r, int x)
+{
+	int cost = 0;
+	for(int k = 0; k < num_reg_vars[r]; k++)
+		cost += only_in(r, reg_vars[r][k], x);
+	return cost;
+}
+
+// Choose the register to compute x = y op z in. A register already holding y
+// is used if y needn't be kept there, then a register whose contents are all
+// dead or saved elsewhere, then the one needing the fewest stores (the one
+// used furthest ahead on ties), storing its contents to memory.
+int getreg(int x, int y, int z)
+{
+	int best = -1, best_cost = INT_MAX, best_next = -1;
+	if(y >= 0)
+		for(int r = 0; r < NUMREGS; r++)
+			if(in_reg[y] & 1 << r && (z < 0 || z == y || !(in_reg[z] & 1 << r)))
+			{
+				// y's old value may be overwritten if it is dead or held elsewhere
+				if(spill_cost(r, x) == 0)
+					return r;
+			}
+	for(int r = 0; r < NUMREGS; r++)
+	{
+		if(z >= 0 && z != y && in_reg[z] & 1 << r)
+			continue;                    // z is still to be read from it
+		int cost = spill_cost(r, x), next = INT_MAX;
+		for(int k = 0; k < num_reg_vars[r]; k++)
+			if(only_in(r, reg_vars[r][k], x) && next_use[reg_vars[r][k]] < next)
+				next = next_use[reg_vars[r][k]];
+		if(cost < best_cost || (cost == best_cost && next > best_next))
+		{
+			best = r;
+			best_cost = cost;
+			best_next = next;
+		}
+	}
+	for(int k = 0; k < num_reg_vars[best]; k++)
+	{
+		int v = reg_vars[best][k];
+		if(only_in(best, v, x))
+		{
+			emit("MOV", vars[v], regname[best]);   // spill
+			in_mem[v] = 1;
+		}
+	}
+	return best;
+}
+
+// Register holding v, or -1
+int reg_of(int v)
+{
+	for(int r = 0; r < NUMREGS; r++)
+		if(v >= 0 && in_reg[v] & 1 << r)
+			return r;
+	return -1;
+}
+
+// Code for x = y op z (or x = y) keeping values in registers, using the
+// register and address descriptors
 void generate_target_code()
 {
+	compute_next_uses();
+	for(int v = 0; v < num_vars; v++)
+	{
+		in_mem[v] = 1;
+		in_reg[v] = 0;
+		next_use[v] = NONE;
+	}
+	memset(num_reg_vars, 0, sizeof(num_reg_vars));
+
+	for(int i = 0; i < num_instr; i++)
+	{
+		int x = tac[i].res_id, y = tac[i].opnd1_id, z = tac[i].opnd2_id;
+		if(y >= 0)
+			next_use[y] = tac[i].opnd1_next;
+		if(z >= 0)
+			next_use[z] = tac[i].opnd2_next;
+		next_use[x] = tac[i].res_next;
+
+		int r;
+		if(tac[i].op == '=' && reg_of(y) >= 0)
+			r = reg_of(y);                   // x shares y's register
+		else
+		{
+			r = getreg(x, y, z);
+			int ry = reg_of(y);
+			if(!(y >= 0 && in_reg[y] & 1 << r))
+				emit("MOV", regname[r], ry >= 0 ? regname[ry] : tac[i].opnd1);
+			// the register now holds only y
+			for(int k = num_reg_vars[r] - 1; k >= 0; k--)
+				if(reg_vars[r][k] != y)
+					remove_from_reg(r, reg_vars[r][k]);
+			if(y >= 0 && tac[i].op == '=')
+				add_to_reg(r, y);
+			if(tac[i].op != '=')
+			{
+				int rz = reg_of(z);
+				emit(get_instr(tac[i].op), regname[r], rz >= 0 ? regname[rz] : tac[i].opnd2);
+				if(y >= 0)
+					remove_from_reg(r, y);   // r holds the result, not y
+			}
+		}
+		// x is now only in register r
+		for(int s = 0; s < NUMREGS; s++)
+			if(s != r)
+				remove_from_reg(s, x);
+		add_to_reg(r, x);
+		in_mem[x] = 0;
+	}
+
+	// store the variables live at the end of the block
+	for(int v = 0; v < num_vars; v++)
+		if(!in_mem[v] && live_out[v] && reg_of(v) >= 0)
+			emit("MOV", vars[v], regname[reg_of(v)]);
+}
+
+// The original translation, every instruction through AX and memory
+void generate_simple_code()
+{
+	for(int i = 0; i < num_instr; i++)
+	{
+		emit("MOV", "AX", tac[i].opnd1);
+		if(tac[i].op != '=')
+			emit(get_instr(tac[i].op), "AX", tac[i].opnd2);
+		emit("MOV", tac[i].res, "AX");
+	}
+}
+
+double elapsed_ms(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+// Global register allocation. Every definition of a variable starts a new
+// value, so in a block a value lives from its definition (or, for the value a
+// variable has on entry, its first use) to its last use. Operands of
+// instruction i are read at position 2i and its result is written at 2i + 1.
+// A second operand different from the first is read after the first operand
+// has been copied into the result's register, so it lives until 2i + 1 and
+// never shares a register with the result.
+#define SPILLED -1
+#define SCRATCH (NUMREGS - 1)    // computes results of spilled values
+
+typedef struct
+{
+	int var;
+	int start, end;
+	int live_in;                 // loaded from memory instead of defined here
+	int uses;
+	int reg;                     // SPILLED if the value stays in memory
+} Interval;
+
+Interval *intervals = NULL;
+int num_intervals = 0, intervals_cap = 0;
+int num_spilled = 0;
+double allocation_ms = 0;
+
+int new_interval(int var, int start, int live_in)
+{
+	if(num_intervals == intervals_cap)
+	{
+		intervals_cap = intervals_cap ? 2 * intervals_cap : 256;
+		intervals = realloc(intervals, intervals_cap * sizeof(Interval));
+	}
+	Interval *iv = &intervals[num_intervals];
+	iv->var = var;
+	iv->start = iv->end = start;
+	iv->live_in = live_in;
+	iv->uses = 0;
+	iv->reg = SPILLED;
+	return num_intervals++;
+}
+
+// The interval of a use of variable v at position pos
+int use_interval(int *current, int v, int pos)
+{
+	if(v < 0)
+		return -1;
+	if(current[v] < 0)
+		current[v] = new_interval(v, pos & ~1, 1);
+	Interval *iv = &intervals[current[v]];
+	if(pos > iv->end)
+		iv->end = pos;
+	iv->uses++;
+	return current[v];
+}
+
+// Split the variables into values and compute their live intervals. The
+// intervals come out ordered by their start. Values of variables other than
+// temporaries that are current at the end of the block live to its end.
+void compute_intervals()
+{
+	int *current = malloc((num_vars + 1) * sizeof(int));
+	for(int v = 0; v < num_vars; v++)
+		current[v] = -1;
+	num_intervals = 0;
+	for(int i = 0; i < num_instr; i++)
+	{
+		int y = tac[i].opnd1_id, z = tac[i].opnd2_id;
+		tac[i].opnd1_iv = use_interval(current, y, 2 * i);
+		tac[i].opnd2_iv = use_interval(current, z, z == y ? 2 * i : 2 * i + 1);
+		tac[i].res_iv = current[tac[i].res_id] = new_interval(tac[i].res_id, 2 * i + 1, 0);
+	}
+	for(int v = 0; v < num_vars; v++)
+		if(current[v] >= 0 && live_out[v] && !intervals[current[v]].live_in)
+			intervals[current[v]].end = 2 * num_instr;
+	free(current);
+}
+
+// A value the variable had on entry that is used once is read from memory
+// where it is used, a register would only add the load
+int memory_only(int n)
+{
+	return intervals[n].live_in && intervals[n].uses == 1;
+}
+
+// Register the result of the instruction starting interval n would like: that
+// of its first operand, which saves a move
+int preferred_reg(int n)
+{
+	if(intervals[n].live_in)
+		return SPILLED;
+	int y = tac[intervals[n].start / 2].opnd1_iv;
+	return y >= 0 ? intervals[y].reg : SPILLED;
+}
+
+// Linear scan over the intervals in order of their start, keeping the active
+// ones sorted by their end. With no register free, the value among the active
+// ones and the new one that ends last is spilled. Returns the number spilled.
+int linear_scan(int k)
+{
+	int active[NUMREGS], num_active = 0, free_regs = (1 << k) - 1, spilled = 0;
+	for(int n = 0; n < num_intervals; n++)
+	{
+		Interval *iv = &intervals[n];
+		int expired = 0;
+		if(memory_only(n))
+		{
+			iv->reg = SPILLED;
+			continue;
+		}
+		while(expired < num_active && intervals[active[expired]].end < iv->start)
+			free_regs |= 1 << intervals[active[expired++]].reg;
+		num_active -= expired;
+		memmove(active, active + expired, num_active * sizeof(int));
+
+		int r = preferred_reg(n);
+		if(free_regs && (r == SPILLED || !(free_regs & 1 << r)))
+			for(r = 0; !(free_regs & 1 << r); r++)
+				;
+		if(free_regs)
+		{
+			iv->reg = r;
+			free_regs &= ~(1 << r);
+		}
+		else
+		{
+			Interval *last = &intervals[active[num_active - 1]];
+			spilled++;
+			if(last->end <= iv->end)
+			{
+				iv->reg = SPILLED;
+				continue;
+			}
+			iv->reg = last->reg;     // the last active value goes to memory
+			last->reg = SPILLED;
+			num_active--;
+		}
+		int a = num_active++;
+		while(a > 0 && intervals[active[a - 1]].end > iv->end)
+		{
+			active[a] = active[a - 1];
+			a--;
+		}
+		active[a] = n;
+	}
+	return spilled;
+}
+
+// Interference graph of the values, the neighbours of value m are
+// interference[interference_start[m]] up to interference_start[m + 1]
+int *interference_start = NULL, *interference = NULL;
+int *by_cost = NULL;             // values by increasing spill cost
+
+// Spill cost of a value when colouring: fewest uses per interference first
+
+int compare_spill_cost(const void *a, const void *b)
+{
+	int m = *(const int *)a, n = *(const int *)b;
+	long dm = interference_start[m + 1] - interference_start[m];
+	long dn = interference_start[n + 1] - interference_start[n];
+	long lhs = (long)intervals[m].uses * dn, rhs = (long)intervals[n].uses * dm;
+	return lhs < rhs ? -1 : lhs > rhs ? 1 : m - n;
+}
+
+// Two values interfere if their intervals overlap. The graph is built
+// sweeping over the intervals in order of their start, counting the edges
+// first and then storing them.
+void build_interference()
+{
+	int n = num_intervals;
+	int *degree = calloc(n + 1, sizeof(int));
+	int *live = malloc((n + 1) * sizeof(int)), num_live = 0;
+	long num_edges = 0;
+
+	// count then store the edges, sweeping over the intervals in order of start
+	for(int pass = 0; pass < 2; pass++)
+	{
+		num_live = 0;
+		for(int m = 0; m < n; m++)
+		{
+			int kept = 0;
+			for(int l = 0; l < num_live; l++)
+				if(intervals[live[l]].end >= intervals[m].start)
+					live[kept++] = live[l];
+			num_live = kept;
+			for(int l = 0; l < num_live; l++)
+				if(pass == 0)
+				{
+					degree[m]++;
+					degree[live[l]]++;
+				}
+				else
+				{
+					interference[degree[m]++] = live[l];
+					interference[degree[live[l]]++] = m;
+				}
+			live[num_live++] = m;
+		}
+		if(pass == 0)
+		{
+			interference_start = realloc(interference_start, (n + 1) * sizeof(int));
+			interference_start[0] = 0;
+			for(int m = 0; m < n; m++)
+				interference_start[m + 1] = interference_start[m] + degree[m];
+			num_edges = interference_start[n];
+			interference = realloc(interference, (num_edges + 1) * sizeof(int));
+			memcpy(degree, interference_start, n * sizeof(int));
+		}
+	}
+	by_cost = realloc(by_cost, (n + 1) * sizeof(int));
+	for(int m = 0; m < n; m++)
+		by_cost[m] = m;
+	qsort(by_cost, n, sizeof(int), compare_spill_cost);
+	free(degree);
+	free(live);
+}
+
+// Chaitin-Briggs graph colouring. Values with fewer than k neighbours are
+// removed and put on a stack until none is left, taking out the cheapest value
+// to spill when every remaining value has k or more. The values are then
+// coloured in the reverse order, and one of the spill candidates whose
+// neighbours took all k colours is spilled. Returns the number spilled.
+int graph_colouring(int k)
+{
+	int n = num_intervals, next_cost = 0;
+	int *degree = malloc((n + 1) * sizeof(int));
+	int *stack = malloc((n + 1) * sizeof(int)), top = 0;
+	int *worklist = malloc((n + 1) * sizeof(int)), num_work = 0;
+	char *removed = calloc(n + 1, 1);
+	for(int m = 0; m < n; m++)
+	{
+		degree[m] = interference_start[m + 1] - interference_start[m];
+		if(degree[m] < k)
+			worklist[num_work++] = m;
+	}
+	while(top < n)
+	{
+		int m;
+		if(num_work > 0)
+			m = worklist[--num_work];
+		else
+		{
+			while(removed[by_cost[next_cost]])
+				next_cost++;
+			m = by_cost[next_cost];      // spill candidate
+		}
+		if(removed[m])
+			continue;
+		removed[m] = 1;
+		stack[top++] = m;
+		for(int e = interference_start[m]; e < interference_start[m + 1]; e++)
+			if(!removed[interference[e]] && degree[interference[e]]-- == k)
+				worklist[num_work++] = interference[e];
+	}
+
+	// select
+	int spilled = 0;
+	for(int m = 0; m < n; m++)
+		intervals[m].reg = SPILLED;
+	while(top > 0)
+	{
+		int m = stack[--top], used = 0;
+		if(memory_only(m))
+			continue;
+		for(int e = interference_start[m]; e < interference_start[m + 1]; e++)
+			if(intervals[interference[e]].reg != SPILLED)
+				used |= 1 << intervals[interference[e]].reg;
+		int r = preferred_reg(m);
+		if(r == SPILLED || used & 1 << r)
+			for(r = 0; r < k && used & 1 << r; r++)
+				;
+		if(r < k)
+			intervals[m].reg = r;
+		else
+			spilled++;
+	}
+	free(degree);
+	free(stack);
+	free(worklist);
+	free(removed);
+	return spilled;
+}
+
+// Where the value of an operand is: its register, its memory or an immediate
+char *location(int iv, char *name)
+{
+	if(iv < 0)
+		return name;
+	if(intervals[iv].reg != SPILLED)
+		return regname[intervals[iv].reg];
+	return vars[intervals[iv].var];
+}
+
+// Load a value the variable had on entry into its register before its first use
+void load_live_in(int iv, int i)
+{
+	if(iv >= 0 && intervals[iv].live_in && intervals[iv].start == 2 * i && intervals[iv].reg != SPILLED)
+		emit("MOV", regname[intervals[iv].reg], vars[intervals[iv].var]);
+}
+
+// Allocate registers to the whole block, with linear scan or graph colouring,
+// and generate its code. All registers are tried first; if anything is spilled
+// the last register is kept back to compute the spilled results in.
+void generate_allocated_code(int colouring)
+{
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	compute_intervals();
+	if(colouring)
+		build_interference();
+	int k = NUMREGS;
+	num_spilled = colouring ? graph_colouring(k) : linear_scan(k);
+	if(num_spilled > 0)
+	{
+		k = NUMREGS - 1;
+		num_spilled = colouring ? graph_colouring(k) : linear_scan(k);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	allocation_ms = elapsed_ms(&start, &end);
+
 	for(int i = 0; i < num_instr; i++)
-		printf("MOV AX, %s\n%s AX, %s \nMOV %s, AX\n", tac[i].opnd1, get_instr(tac[i].op), tac[i].opnd2, tac[i].res);
+	{
+		int x = tac[i].res_iv, y = tac[i].opnd1_iv, z = tac[i].opnd2_iv;
+		load_live_in(y, i);
+		if(z != y)
+			load_live_in(z, i);
+		char *src = location(y, tac[i].opnd1);
+		char *dst = intervals[x].reg != SPILLED ? regname[intervals[x].reg] : regname[SCRATCH];
+		if(tac[i].op == '=' && intervals[x].reg == SPILLED && !is_mem(src))
+		{
+			emit("MOV", vars[intervals[x].var], src);
+			continue;
+		}
+		if(strcmp(dst, src) != 0)
+			emit("MOV", dst, src);
+		if(tac[i].op != '=')
+			emit(get_instr(tac[i].op), dst, location(z, tac[i].opnd2));
+		if(intervals[x].reg == SPILLED)
+			emit("MOV", vars[intervals[x].var], dst);
+	}
+
+	// store the values live at the end of the block
+	for(int n = 0; n < num_intervals; n++)
+		if(intervals[n].end == 2 * num_instr && intervals[n].reg != SPILLED)
+			emit("MOV", vars[intervals[n].var], regname[intervals[n].reg]);
 }
 
-int main()
+int is_reg(const char *opnd)
 {
-	readThreeAddressCode();
-	printf("Equivalent assembly code is:\n");
-	generate_target_code();
+	return opnd[0] != '\0' && !is_mem(opnd) && !isdigit((unsigned char)opnd[0]);
+}
+
+// log2 of n if it is a power of two greater than 1, else -1
+int log2_exact(const char *n)
+{
+	if(!isdigit((unsigned char)n[0]))
+		return -1;
+	long v = atol(n);
+	int k = 0;
+	while(v > 1 && v % 2 == 0)
+	{
+		v /= 2;
+		k++;
+	}
+	return v == 1 && k > 0 ? k : -1;
+}
+
+// Rules on the last instruction of the code alone. Returns 1 if it changed.
+int peephole_one(int *out)
+{
+	AsmInstr *b = &code[*out - 1];
+	int k;
+	if((strcmp(b->op, "MOV") == 0 && strcmp(b->dst, b->src) == 0) ||
+	   ((strcmp(b->op, "ADD") == 0 || strcmp(b->op, "SUB") == 0) && strcmp(b->src, "0") == 0) ||
+	   ((strcmp(b->op, "MUL") == 0 || strcmp(b->op, "DIV") == 0) && strcmp(b->src, "1") == 0))
+	{
+		(*out)--;                        // x + 0, x * 1, ... and moves to itself
+		removed_identities++;
+		return 1;
+	}
+	if(strcmp(b->op, "MUL") == 0 && strcmp(b->src, "0") == 0)
+	{
+		b->op = "MOV";                   // x * 0 is 0
+		removed_identities++;
+		return 1;
+	}
+	if(strcmp(b->op, "MUL") == 0 && (k = log2_exact(b->src)) > 0)
+	{
+		static char counts[64][3];
+		b->op = "SHL";                   // x * 2^k is x << k
+		counts[k][0] = '0' + k / 10;     // k < 64
+		counts[k][k >= 10] = '0' + k % 10;
+		b->src = counts[k];
+		num_reductions++;
+		return 1;
+	}
+	return 0;
+}
+
+// Rules on the last two instructions of the code. Returns 1 if they changed.
+int peephole_two(int *out)
+{
+	if(*out < 2)
+		return 0;
+	AsmInstr *a = &code[*out - 2], *b = &code[*out - 1];
+	if(strcmp(a->op, "MOV") != 0 || strcmp(b->op, "MOV") != 0)
+		return 0;
+	if(strcmp(a->dst, b->src) == 0 && strcmp(a->src, b->dst) == 0)
+	{
+		(*out)--;                        // MOV x, R / MOV R, x and MOV R, x / MOV x, R
+		removed_moves++;
+		return 1;
+	}
+	if(is_reg(a->dst) && strcmp(a->dst, b->dst) == 0 && strcmp(b->src, a->dst) != 0)
+	{
+		*a = *b;                         // a register load overwritten before it is read
+		(*out)--;
+		removed_loads++;
+		return 1;
+	}
+	return 0;
+}
+
+// Slide a window over the code, applying the rules to the end of the code
+// produced so far. After a change the rules are tried again on the new end,
+// so every instruction is added once and removed at most once.
+void peephole_window()
+{
+	int out = 0;
+	for(int i = 0; i < num_code; i++)
+	{
+		code[out++] = code[i];
+		while(out > 0 && (peephole_one(&out) || peephole_two(&out)))
+			;
+	}
+	num_code = out;
+}
+
+// Remove stores to variables that are overwritten or, for temporaries, dead
+// before they are read again. One backward pass.
+void remove_dead_stores()
+{
+	int *live = malloc((num_vars + 1) * sizeof(int)), keep = num_code;
+	for(int v = 0; v < num_vars; v++)
+		live[v] = live_out[v];
+	for(int i = num_code - 1; i >= 0; i--)
+	{
+		AsmInstr c = code[i];
+		int d = is_mem(c.dst) ? find_var(c.dst) : -1, s = is_mem(c.src) ? find_var(c.src) : -1;
+		if(d >= 0 && strcmp(c.op, "MOV") == 0)
+		{
+			if(!live[d])
+			{
+				removed_stores++;
+				continue;
+			}
+			live[d] = 0;
+		}
+		else if(d >= 0)
+			live[d] = 1;                 // arithmetic on memory reads it too
+		if(s >= 0)
+			live[s] = 1;
+		code[--keep] = c;
+	}
+	memmove(code, code + keep, (num_code - keep) * sizeof(AsmInstr));
+	num_code -= keep;
+	free(live);
+}
+
+// Run the peephole rules and dead store removal until neither changes anything
+void peephole()
+{
+	int changed;
+	do
+	{
+		int before = num_code, reductions = num_reductions, identities = removed_identities;
+		remove_dead_stores();
+		peephole_window();
+		changed = num_code != before || num_reductions != reductions || removed_identities != identities;
+	} while(changed);
+}
+
+// x86-64 machine code for the assembly, run as a function void f(int64_t *slots)
+// over one 64 bit slot per variable. AX, BX, CX and DX are r8 to r11, a
+// variable is the slot [rdi + 8 * id], and rax, rcx and rdx are scratch.
+#define RAX 0
+#define RCX 1
+#define RDI 7
+#define JIT_MAX 48               // bytes of machine code per instruction at most
+
+enum { JIT_REG, JIT_MEM, JIT_IMM };
+
+typedef struct
+{
+	int kind;
+	int reg;                     // register number
+	int64_t value;               // immediate or slot
+} JitOpnd;
+
+unsigned char *jit_code = NULL;
+size_t jit_len = 0;
+
+void jit_byte(int b)
+{
+	jit_code[jit_len++] = b;
+}
+
+void jit_imm32(int32_t v)
+{
+	memcpy(jit_code + jit_len, &v, 4);
+	jit_len += 4;
+}
+
+JitOpnd jit_reg(int reg)
+{
+	JitOpnd o = {JIT_REG, reg, 0};
+	return o;
+}
+
+JitOpnd jit_opnd(const char *name)
+{
+	JitOpnd o = {JIT_IMM, 0, 0};
+	if(isdigit((unsigned char)name[0]))
+		o.value = strtoll(name, NULL, 10);
+	else if(name[0] >= 'A' && name[0] < 'A' + NUMREGS && name[1] == 'X' && name[2] == '\0')
+	{
+		o.kind = JIT_REG;        // AX, BX, CX, DX
+		o.reg = 8 + name[0] - 'A';
+	}
+	else
+	{
+		o.kind = JIT_MEM;
+		o.value = find_var(name);
+	}
+	return o;
+}
+
+int fits_imm32(int64_t v)
+{
+	return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+// REX.W, the opcode (two bytes if above 0xff) and the ModRM byte with r in
+// its reg field and m as the register or memory operand
+void jit_insn(int opcode, int r, JitOpnd m)
+{
+	jit_byte(0x48 | (r & 8) >> 1 | (m.kind == JIT_REG ? (m.reg & 8) >> 3 : 0));
+	if(opcode > 0xff)
+		jit_byte(opcode >> 8);
+	jit_byte(opcode & 0xff);
+	if(m.kind == JIT_REG)
+		jit_byte(0xc0 | (r & 7) << 3 | (m.reg & 7));
+	else
+	{
+		jit_byte(0x80 | (r & 7) << 3 | RDI);     // [rdi + disp32]
+		jit_imm32((int32_t)(m.value * 8));
+	}
+}
+
+// An immediate that doesn't fit in 32 bits goes through rcx
+JitOpnd jit_imm64(JitOpnd src)
+{
+	if(src.kind != JIT_IMM || fits_imm32(src.value))
+		return src;
+	jit_byte(0x48);
+	jit_byte(0xb8 | RCX);                        // movabs rcx, imm64
+	memcpy(jit_code + jit_len, &src.value, 8);
+	jit_len += 8;
+	return jit_reg(RCX);
+}
+
+void jit_mov(JitOpnd dst, JitOpnd src)
+{
+	src = jit_imm64(src);
+	if(src.kind == JIT_IMM)
+	{
+		jit_insn(0xc7, 0, dst);
+		jit_imm32((int32_t)src.value);
+	}
+	else if(src.kind == JIT_REG)
+		jit_insn(0x89, src.reg, dst);
+	else if(dst.kind == JIT_REG)
+		jit_insn(0x8b, dst.reg, src);
+	else
+	{
+		jit_mov(jit_reg(RAX), src);
+		jit_mov(dst, jit_reg(RAX));
+	}
+}
+
+// dst = dst op src. A division by 0 gives 0 and one by -1 negates, where idiv
+// would trap.
+void jit_arith(const char *op, JitOpnd dst, JitOpnd src)
+{
+	if(dst.kind == JIT_MEM)
+	{
+		JitOpnd t = jit_reg(RAX);
+		jit_mov(t, dst);
+		jit_arith(op, t, src);
+		jit_mov(dst, t);
+		return;
+	}
+	if(strcmp(op, "DIV") == 0)
+	{
+		int checked = src.kind != JIT_IMM || src.value == 0 || src.value == -1;
+		jit_mov(jit_reg(RCX), src);
+		jit_mov(jit_reg(RAX), dst);
+		static const unsigned char guarded[] = {
+			0x48, 0x85, 0xc9,                    // test rcx, rcx
+			0x74, 0x12,                          // jz zero
+			0x48, 0x83, 0xf9, 0xff,              // cmp rcx, -1
+			0x74, 0x07};                         // je negate
+		static const unsigned char divide[] = {
+			0x48, 0x99,                          // cqo
+			0x48, 0xf7, 0xf9};                   // idiv rcx
+		static const unsigned char special[] = {
+			0xeb, 0x07,                          // jmp done
+			0x48, 0xf7, 0xd8,                    // negate: neg rax
+			0xeb, 0x02,                          // jmp done
+			0x31, 0xc0};                         // zero: xor eax, eax
+		if(checked)
+		{
+			memcpy(jit_code + jit_len, guarded, sizeof(guarded));
+			jit_len += sizeof(guarded);
+		}
+		memcpy(jit_code + jit_len, divide, sizeof(divide));
+		jit_len += sizeof(divide);
+		if(checked)
+		{
+			memcpy(jit_code + jit_len, special, sizeof(special));
+			jit_len += sizeof(special);
+		}
+		jit_mov(dst, jit_reg(RAX));
+		return;
+	}
+	if(strcmp(op, "SHL") == 0)
+	{
+		jit_insn(0xc1, 4, dst);
+		jit_byte(src.value & 63);
+		return;
+	}
+	src = jit_imm64(src);
+	int add = strcmp(op, "ADD") == 0, sub = strcmp(op, "SUB") == 0;
+	if(src.kind == JIT_IMM && (add || sub))
+	{
+		jit_insn(0x81, add ? 0 : 5, dst);
+		jit_imm32((int32_t)src.value);
+	}
+	else if(src.kind == JIT_IMM)
+	{
+		jit_insn(0x69, dst.reg, dst);             // imul dst, dst, imm32
+		jit_imm32((int32_t)src.value);
+	}
+	else
+		jit_insn(add ? 0x03 : sub ? 0x2b : 0x0faf, dst.reg, src);
+}
+
+// Encode the code into an executable buffer. Returns NULL if it can't be mapped.
+typedef void (*JitFunction)(int64_t *slots);
+
+JitFunction jit_compile()
+{
+	size_t size = (size_t)num_code * JIT_MAX + 1;
+	jit_code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(jit_code == MAP_FAILED)
+		return NULL;
+	jit_len = 0;
+	for(int i = 0; i < num_code; i++)
+	{
+		JitOpnd dst = jit_opnd(code[i].dst), src = jit_opnd(code[i].src);
+		if(strcmp(code[i].op, "MOV") == 0)
+			jit_mov(dst, src);
+		else
+			jit_arith(code[i].op, dst, src);
+	}
+	jit_byte(0xc3);                              // ret
+	if(mprotect(jit_code, size, PROT_READ | PROT_EXEC) != 0)
+		return NULL;
+	return (JitFunction)jit_code;
+}
+
+// The TAC with operands decoded to slots, for the interpreter
+typedef struct
+{
+	char op;
+	int x, y, z;                 // slots, -1 for a constant
+	int64_t a, b;                // constant operands
+} Decoded;
+
+Decoded *decode_tac()
+{
+	Decoded *d = malloc((num_instr + 1) * sizeof(Decoded));
+	for(int i = 0; i < num_instr; i++)
+	{
+		d[i].op = tac[i].op;
+		d[i].x = tac[i].res_id;
+		d[i].y = tac[i].opnd1_id;
+		d[i].z = tac[i].opnd2_id;
+		d[i].a = d[i].y < 0 ? strtoll(tac[i].opnd1, NULL, 10) : 0;
+		d[i].b = d[i].z < 0 && tac[i].op != '=' ? strtoll(tac[i].opnd2, NULL, 10) : 0;
+	}
+	return d;
+}
+
+// Run the TAC over the slots, with the arithmetic of the machine code
+void interpret(Decoded *d, int64_t *slots)
+{
+	for(int i = 0; i < num_instr; i++)
+	{
+		uint64_t a = d[i].y >= 0 ? slots[d[i].y] : d[i].a;
+		uint64_t b = d[i].z >= 0 ? slots[d[i].z] : d[i].b, r;
+		switch(d[i].op)
+		{
+		case '+': r = a + b; break;
+		case '-': r = a - b; break;
+		case '*': r = a * b; break;
+		case '/': r = (int64_t)b == 0 ? 0 : (int64_t)b == -1 ? -a : (uint64_t)((int64_t)a / (int64_t)b); break;
+		default:  r = a; break;
+		}
+		slots[d[i].x] = r;
+	}
+}
+
+// Compile the code, check it computes what the interpreter does and time both.
+// Returns 0 if they agree.
+int jit_benchmark(double translate_ms)
+{
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	JitFunction f = jit_compile();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if(f == NULL)
+	{
+		perror("mmap");
+		return 1;
+	}
+	double encode_ms = elapsed_ms(&start, &end);
+
+	Decoded *d = decode_tac();
+	int64_t *jit_slots = malloc((num_vars + 1) * sizeof(int64_t));
+	int64_t *interp_slots = malloc((num_vars + 1) * sizeof(int64_t));
+	for(int v = 0; v < num_vars; v++)
+		jit_slots[v] = interp_slots[v] = v % 19 - 9;
+	f(jit_slots);
+	interpret(d, interp_slots);
+	int differ = 0;
+	for(int v = 0; v < num_vars; v++)
+		if(!is_temp(vars[v]) && jit_slots[v] != interp_slots[v])
+		{
+			if(differ++ == 0)
+				printf("JIT gives %s = %lld, the interpreter %lld\n", vars[v],
+					(long long)jit_slots[v], (long long)interp_slots[v]);
+		}
+
+	// about 2 * 10^7 instructions of each
+	int runs = num_instr > 0 ? 20000000 / num_instr + 1 : 1;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int k = 0; k < runs; k++)
+		f(jit_slots);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double jit_ms = elapsed_ms(&start, &end);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(int k = 0; k < runs; k++)
+		interpret(d, interp_slots);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double interp_ms = elapsed_ms(&start, &end);
+
+	double per_run = 1e6 / ((double)runs * (num_instr ? num_instr : 1));
+	printf("JIT: %zu bytes of machine code, %.1f ns per instruction to generate (%.1f translating, %.1f encoding)\n",
+		jit_len, (translate_ms + encode_ms) * 1e6 / (num_instr ? num_instr : 1),
+		translate_ms * 1e6 / (num_instr ? num_instr : 1), encode_ms * 1e6 / (num_instr ? num_instr : 1));
+	printf("Run: %.2f ns per instruction, interpreter %.2f ns (%.1f times faster); results %s\n",
+		jit_ms * per_run, interp_ms * per_run, interp_ms / (jit_ms > 0 ? jit_ms : 1e-9), differ ? "differ" : "agree");
+	munmap(jit_code, (size_t)num_code * JIT_MAX + 1);
+	free(d);
+	free(jit_slots);
+	free(interp_slots);
+	return differ != 0;
+}
+
+// xorshift64*, so a seed gives the same program every time
+uint64_t rng_state = 1;
+
+int random_below(int n)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (int)((rng_state * 2685821657736338717ULL >> 33) % (uint64_t)n);
+}
+
+// A block of n instructions in the shape of translated expressions: most
+// results are new temporaries, operands are mostly recent temporaries, and
+// every so often a temporary is assigned to one of 16 variables
+void generate_block(int n)
+{
+	int temps = 0;
+	char name[16];
+	grow_tac(n);
+	for(num_instr = 0; num_instr < n; num_instr++)
+	{
+		char **opnd[2] = {&tac[num_instr].opnd1, &tac[num_instr].opnd2};
+		for(int k = 0; k < 2; k++)
+		{
+			int c = random_below(8);
+			if(c < 5 && temps > 0)
+				snprintf(name, sizeof(name), "t%d", temps - random_below(temps < 12 ? temps : 12));
+			else if(c < 7)
+				snprintf(name, sizeof(name), "%c", 'a' + random_below(16));
+			else
+				snprintf(name, sizeof(name), "%d", 1 + random_below(9));
+			*opnd[k] = intern(&names[0], name, strlen(name));
+		}
+		if(random_below(8) == 0 && temps > 0)
+		{
+			snprintf(name, sizeof(name), "%c", 'a' + random_below(16));
+			tac[num_instr].res = intern(&names[0], name, strlen(name));
+			snprintf(name, sizeof(name), "t%d", temps);
+			tac[num_instr].opnd1 = intern(&names[0], name, strlen(name));
+			tac[num_instr].op = '=';
+			tac[num_instr].opnd2 = "";
+		}
+		else
+		{
+			snprintf(name, sizeof(name), "t%d", ++temps);
+			tac[num_instr].res = intern(&names[0], name, strlen(name));
+			tac[num_instr].op = "+-*"[random_below(3)];
+		}
+	}
+}
+
+// Totals over the blocks
+long simple_emitted = 0, simple_mem_ops = 0, getreg_emitted = 0, getreg_mem_ops = 0;
+long num_emitted = 0, num_mem_ops = 0, before_peephole = 0, total_values = 0, total_spilled = 0;
+long total_instr = 0;
+double translate_ms = 0, total_allocation_ms = 0;
+
+// Translate the block tac[0] to tac[num_instr - 1] and print its code
+void translate_block(int simple, int allocator, int optimise, int quiet)
+{
+	int emitted, mem_ops;
+	compute_next_uses();
+	total_instr += num_instr;
+
+	// statistics of the simple and getreg translations, for comparison
+	generate_simple_code();
+	count_code(&emitted, &mem_ops);
+	simple_emitted += emitted;
+	simple_mem_ops += mem_ops;
+	num_code = 0;
+	if(allocator)
+	{
+		generate_target_code();
+		count_code(&emitted, &mem_ops);
+		getreg_emitted += emitted;
+		getreg_mem_ops += mem_ops;
+		num_code = 0;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if(simple)
+		generate_simple_code();
+	else if(allocator)
+	{
+		generate_allocated_code(allocator == 'c');
+		total_values += num_intervals;
+		total_spilled += num_spilled;
+		total_allocation_ms += allocation_ms;
+	}
+	else
+		generate_target_code();
+	before_peephole += num_code;
+	if(optimise)
+		peephole();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	translate_ms += elapsed_ms(&start, &end);
+	if(!quiet)
+		print_code();
+	count_code(&emitted, &mem_ops);
+	num_emitted += emitted;
+	num_mem_ops += mem_ops;
+}
+
+// Usage: ./a.out [-n] [-p] [-l | -c] [-g n] [-q] [-j] [file]
+//   -n    use the simple one register translation
+//   -p    run the peephole optimiser over the code
+//   -l    allocate registers to the whole block by linear scan
+//   -c    allocate registers to the whole block by graph colouring
+//   -g n  translate a generated block of n instructions instead of reading one
+//   -q    don't print the code, only the statistics
+//   -j    compile the code to x86-64 and time it against an interpreter
+// The instructions are read from the file, or the standard input, in blocks of
+// BATCH instructions (all of them with -j).
+int main(int argc, char *argv[])
+{
+	int simple = 0, optimise = 0, allocator = 0, generate = 0, quiet = 0, jit = 0;
+	char *path = NULL;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-n") == 0)
+			simple = 1;
+		else if(strcmp(argv[i], "-p") == 0)
+			optimise = 1;
+		else if(strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "-c") == 0)
+			allocator = argv[i][1];
+		else if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+			generate = atoi(argv[++i]);
+		else if(strcmp(argv[i], "-q") == 0)
+			quiet = 1;
+		else if(strcmp(argv[i], "-j") == 0)
+			jit = 1;
+		else
+			path = argv[i];
+	}
+	in = stdin;
+	if(path && (in = fopen(path, "r")) == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+	interactive = isatty(fileno(in));
+	if(interactive && generate <= 0)
+	{
+		printf("Enter each instruction, seperate result opcodes and operands by space\n");
+		printf("Eg. s = a + b\n");
+		printf("End with an empty line\n");
+	}
+
+	int blocks = 0;
+	if(generate > 0)
+	{
+		generate_block(generate);
+		if(!quiet)
+			out_str("Equivalent assembly code is:\n");
+		translate_block(simple, allocator, optimise, quiet);
+		blocks = 1;
+	}
+	else
+	{
+		// translate a block while the next one is read, to know which
+		// temporaries it still needs
+		int limit = jit ? INT_MAX : BATCH, cur = 0;
+		int n = read_instructions(&names[cur], 0, limit);
+		if(!quiet)
+			out_str("Equivalent assembly code is:\n");
+		while(n > 0)
+		{
+			num_lookahead = read_instructions(&names[!cur], n, limit);
+			more_input = !in_eof || in_pos < in_len;
+			num_instr = n;
+			translate_block(simple, allocator, optimise, quiet);
+			blocks++;
+			if(jit)
+				break;
+			n = num_lookahead;
+			memmove(tac, tac + num_instr, n * sizeof(*tac));
+			clear_names(&names[cur]);
+			cur = !cur;
+		}
+	}
+	out_flush();
+
+	printf("Instructions: %ld (simple translation %ld), memory operations: %ld (simple translation %ld)\n",
+		num_emitted, simple_emitted, num_mem_ops, simple_mem_ops);
+	if(allocator && !simple)
+		printf("%s: %ld values, %ld spilled, %.3f ms; instructions %ld and memory operations %ld with getreg\n",
+			allocator == 'c' ? "Graph colouring" : "Linear scan", total_values, total_spilled,
+			total_allocation_ms, getreg_emitted, getreg_mem_ops);
+	if(optimise)
+		printf("Peephole: %ld to %ld instructions; removed %d redundant moves, %d dead stores, "
+			"%d overwritten loads, %d identities; %d strength reductions\n",
+			before_peephole, num_emitted, removed_moves, removed_stores, removed_loads, removed_identities, num_reductions);
+	if(!interactive)
+		fprintf(stderr, "%ld instructions, %d blocks, translated in %.3f s\n", total_instr, blocks, translate_ms / 1e3);
+	if(jit && blocks > 0)
+		return jit_benchmark(translate_ms);
+	return 0;
 }
@@ -2,15 +2,56 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
-#define MAX 50
-
-bool epstable[MAX][MAX] = {false};
 int numstates, numtrans;
 
+// Epsilon moves, read as pairs and then kept in compressed rows: the moves
+// out of state i go to epsto[epsstart[i]] up to epsto[epsstart[i + 1] - 1]
+int *epsfrom, *epsto, *epsstart, numeps, epscap;
+
+// Strongly connected components of the epsilon moves, numbered in the order
+// Tarjan's algorithm finds them, so the moves out of a component only lead to
+// components with smaller numbers
+int *scc, numscc;
+int *members, *memberstart;
+
+// The closure of each component as a sorted list of states
+int *closure, *closurestart, closurelen, closurecap;
+
+void add_eps(int i, int j)
+{
+	if (numeps == epscap)
+	{
+		epscap = epscap ? 2 * epscap : 1024;
+		epsfrom = realloc(epsfrom, epscap * sizeof(int));
+		epsto = realloc(epsto, epscap * sizeof(int));
+	}
+	epsfrom[numeps] = i;
+	epsto[numeps++] = j;
+}
+
+// sort the moves by their source
+void sort_eps()
+{
+	int *to = malloc((numeps + 1) * sizeof(int));
+	epsstart = calloc(numstates + 1, sizeof(int));
+	for (int e = 0; e < numeps; e++)
+		epsstart[epsfrom[e] + 1]++;
+	for (int i = 0; i < numstates; i++)
+		epsstart[i + 1] += epsstart[i];
+	for (int e = 0; e < numeps; e++)
+		to[epsstart[epsfrom[e]]++] = epsto[e];
+	for (int i = numstates; i > 0; i--)
+		epsstart[i] = epsstart[i - 1];
+	epsstart[0] = 0;
+	free(epsto);
+	epsto = to;
+}
+
 void get_enfa()
 {
-	char transition[MAX], *p;
+	char transition[64], *p;
 
 	printf("Enter the number of states n, states will be named from q0 to q(n-1)\n");
 	scanf("%d", &numstates);
@@ -21,57 +62,334 @@ void get_enfa()
 	printf("Enter all the transitions as state symbol state(no space in between), eg q0aq1, use # for epsilon\n");
 	for (int i = 0; i < numtrans; i++)
 	{
-		scanf("%s", transition);
+		if (scanf("%63s", transition) != 1)
+			break;
 //		printf("%s", transition);
 
 		if ((p = strchr(transition, '#')) != NULL)
 		{
 			int i, j;
-			sscanf(transition, "q%d", &i);
+			if (sscanf(transition, "q%d", &i) != 1 || p[1] != 'q')
+				continue;
 			j = atoi(p+2);
-			epstable[i][j] = true;
+			if (i < 0 || i >= numstates || j < 0 || j >= numstates)
+			{
+				fprintf(stderr, "%s: no such state\n", transition);
+				continue;
+			}
+			add_eps(i, j);
 		}
 	}
+	sort_eps();
 }
 
+// The automaton can also be loaded from a file in the formats 17pgm's nfa.h
+// describes, text starting with the line "nfa <states> <symbols>" or binary
+// starting with "NFA" and a byte 1. Only the epsilon moves are kept: in text
+// the lines "<from> # <to>", and in binary the rows at the end of the file,
+// which are read as they are.
+bool load_text(char *p, const char *path)
+{
+	long line = 0;
+	numstates = -1;
+	while (*p)
+	{
+		char *eol = strchr(p, '\n'), *q, *end;
+		if (eol)
+			*eol = '\0';
+		line++;
+		q = p + strspn(p, " \t\r");
+		if (*q == '\0' || *q == '#' || *q == '*')
+			;	// a blank line, a comment or accepting states
+		else if (numstates < 0)
+		{
+			if (sscanf(q, "nfa %d", &numstates) != 1 || numstates < 0)
+			{
+				fprintf(stderr, "%s:%ld: expected nfa and the number of states\n", path, line);
+				return false;
+			}
+		}
+		else
+		{
+			long i = strtol(q, &end, 10), j = -1;
+			if (end > q)
+			{
+				q = end + strspn(end, " \t\r");
+				if (*q)
+					j = strtol(q + 1, &end, 10);
+			}
+			if (j < 0 || end == q + 1 || i < 0 || i >= numstates || j >= numstates)
+				fprintf(stderr, "%s:%ld: bad move\n", path, line);
+			else if (*q == '#')
+				add_eps(i, j);
+		}
+		p = eol ? eol + 1 : q + strlen(q);
+	}
+	if (numstates < 0)
+	{
+		fprintf(stderr, "%s: no nfa line\n", path);
+		return false;
+	}
+	sort_eps();
+	return true;
+}
 
-void findeclose(int state, bool visited[])
+bool load_binary(FILE *in, long len, const char *path)
 {
-	visited[state] = true;
+	uint32_t size[3];
+	uint64_t moves[2];
+	if (fread(size, sizeof(uint32_t), 3, in) != 3 || fread(moves, sizeof(uint64_t), 2, in) != 2
+		|| size[0] > INT32_MAX || size[1] > 256 || moves[0] > INT64_MAX / 8 || moves[1] > INT32_MAX)
+	{
+		fprintf(stderr, "%s: bad header\n", path);
+		return false;
+	}
+	numstates = size[0];
+	numeps = moves[1];
 
+	// skip the symbols, the accepting states and the moves on symbols
+	long skip = ((size[1] + 3) & ~3) + 4 * (size[2] + (long)size[0] * size[1] + (long)moves[0]);
+	if (32 + skip + 4 * ((long)numstates + numeps) != len)
+	{
+		fprintf(stderr, "%s: not the size its header gives\n", path);
+		return false;
+	}
+	epsstart = malloc((numstates + 1) * sizeof(int));
+	epsto = malloc((numeps + 1) * sizeof(int));
+	epsstart[0] = 0;
+	if (fseek(in, skip, SEEK_CUR) != 0 || fread(epsstart + 1, sizeof(int), numstates, in) != (size_t)numstates)
+	{
+		fprintf(stderr, "%s: truncated\n", path);
+		return false;
+	}
+	long total = 0;
+	for (int i = 1; i <= numstates; i++)
+	{
+		total += (uint32_t)epsstart[i];
+		epsstart[i] = total;
+	}
+	bool bad = total != numeps || fread(epsto, sizeof(int), numeps, in) != (size_t)numeps;
+	for (int e = 0; e < numeps; e++)
+		bad |= (unsigned)epsto[e] >= (unsigned)numstates;
+	if (bad)
+		fprintf(stderr, "%s: a state out of range, or truncated\n", path);
+	return !bad;
+}
+
+bool load_enfa(const char *path)
+{
+	FILE *in = fopen(path, "rb");
+	char magic[4];
+	long len;
+	bool ok;
+	if (!in)
+	{
+		perror(path);
+		return false;
+	}
+	fseek(in, 0, SEEK_END);
+	len = ftell(in);
+	rewind(in);
+	if (fread(magic, 1, 4, in) == 4 && memcmp(magic, "NFA\1", 4) == 0)
+		ok = load_binary(in, len, path);
+	else
+	{
+		rewind(in);
+		char *text = malloc(len + 1);
+		text[fread(text, 1, len, in)] = '\0';
+		ok = load_text(text, path);
+		free(text);
+	}
+	fclose(in);
+	return ok;
+}
+
+// Tarjan's algorithm, with an explicit stack so long chains of epsilon moves
+// can't overflow the call stack
+void findsccs()
+{
+	int *index = malloc(numstates * sizeof(int)), *low = malloc(numstates * sizeof(int));
+	int *stack = malloc(numstates * sizeof(int)), *calls = malloc(numstates * sizeof(int));
+	int *next = malloc(numstates * sizeof(int));
+	bool *onstack = calloc(numstates, sizeof(bool));
+	int counter = 0, top = 0;
+
+	scc = malloc(numstates * sizeof(int));
+	numscc = 0;
 	for (int i = 0; i < numstates; i++)
+		index[i] = -1;
+
+	for (int s = 0; s < numstates; s++)
 	{
-		if(epstable[state][i] && !visited[i])
+		if (index[s] >= 0)
+			continue;
+		int depth = 0;
+		calls[depth++] = s;
+		index[s] = low[s] = counter++;
+		next[s] = epsstart[s];
+		stack[top++] = s;
+		onstack[s] = true;
+		while (depth > 0)
 		{
-			findeclose(i, visited);
+			int v = calls[depth - 1];
+			if (next[v] < epsstart[v + 1])
+			{
+				int w = epsto[next[v]++];
+				if (index[w] < 0)
+				{
+					index[w] = low[w] = counter++;
+					next[w] = epsstart[w];
+					stack[top++] = w;
+					onstack[w] = true;
+					calls[depth++] = w;
+				}
+				else if (onstack[w] && index[w] < low[v])
+					low[v] = index[w];
+				continue;
+			}
+			if (--depth > 0 && low[v] < low[calls[depth - 1]])
+				low[calls[depth - 1]] = low[v];
+			if (low[v] == index[v])
+			{
+				int w;
+				do
+				{
+					w = stack[--top];
+					onstack[w] = false;
+					scc[w] = numscc;
+				} while (w != v);
+				numscc++;
+			}
 		}
 	}
+
+	// the states of each component
+	members = malloc((numstates + 1) * sizeof(int));
+	memberstart = calloc(numscc + 1, sizeof(int));
+	for (int i = 0; i < numstates; i++)
+		memberstart[scc[i] + 1]++;
+	for (int c = 0; c < numscc; c++)
+		memberstart[c + 1] += memberstart[c];
+	for (int i = 0; i < numstates; i++)
+		members[memberstart[scc[i]]++] = i;
+	for (int c = numscc; c > 0; c--)
+		memberstart[c] = memberstart[c - 1];
+	memberstart[0] = 0;
+
+	free(index);
+	free(low);
+	free(stack);
+	free(calls);
+	free(next);
+	free(onstack);
 }
 
-void printeclose()
+// Closures of all the states at once. A component's closure is its states
+// together with the closures of the components its moves lead to, which are
+// all numbered lower, so one pass in order of number computes them all. Each
+// closure is a row of 64 bit words covering only the words from its lowest to
+// its highest state, made by ORing the rows it includes word by word, and is
+// freed once every component needing it has been done.
+void findeclose()
 {
-	for(int i = 0; i < numstates; i++)
+	findsccs();
+	uint64_t **row = malloc((numscc + 1) * sizeof(uint64_t *));
+	int *rowlo = malloc((numscc + 1) * sizeof(int)), *rowhi = malloc((numscc + 1) * sizeof(int));
+	int *users = calloc(numscc + 1, sizeof(int));
+
+	for (int u = 0; u < numstates; u++)
+		for (int e = epsstart[u]; e < epsstart[u + 1]; e++)
+			if (scc[epsto[e]] != scc[u])
+				users[scc[epsto[e]]]++;
+
+	closurestart = malloc((numscc + 1) * sizeof(int));
+	closurelen = 0;
+	for (int c = 0; c < numscc; c++)
 	{
-		bool visited[MAX] = {false};
-		char outstr[MAX] = {'\0'}, tempstr[MAX] = {'\0'};
-		findeclose(i, visited);
-		printf("e-closure(q%d) = {", i);
-		for(int j = 0; j < numstates; j++)
+		int lo = members[memberstart[c]] >> 6, hi = lo + 1;
+		for (int k = memberstart[c]; k < memberstart[c + 1]; k++)
 		{
-			if(visited[j])
+			int u = members[k];
+			if (u >> 6 < lo)
+				lo = u >> 6;
+			if (u >> 6 >= hi)
+				hi = (u >> 6) + 1;
+			for (int e = epsstart[u]; e < epsstart[u + 1]; e++)
 			{
-				sprintf(tempstr, "q%d,", j);
-				strcat(outstr, tempstr);
+				int d = scc[epsto[e]];
+				if (d != c && rowlo[d] < lo)
+					lo = rowlo[d];
+				if (d != c && rowhi[d] > hi)
+					hi = rowhi[d];
 			}
 		}
-		outstr[strlen(outstr)-1] = '\0';
-		printf("%s}\n", outstr);
+
+		uint64_t *r = calloc(hi - lo, sizeof(uint64_t));
+		for (int k = memberstart[c]; k < memberstart[c + 1]; k++)
+		{
+			int u = members[k];
+			r[(u >> 6) - lo] |= 1ULL << (u & 63);
+			for (int e = epsstart[u]; e < epsstart[u + 1]; e++)
+			{
+				int d = scc[epsto[e]];
+				if (d == c)
+					continue;
+				for (int w = rowlo[d]; w < rowhi[d]; w++)
+					r[w - lo] |= row[d][w - rowlo[d]];
+				if (--users[d] == 0)
+					free(row[d]);
+			}
+		}
+
+		// keep the closure as a list of states
+		closurestart[c] = closurelen;
+		for (int w = lo; w < hi; w++)
+		{
+			int count = __builtin_popcountll(r[w - lo]);
+			if (closurelen + count > closurecap)
+			{
+				closurecap = 2 * (closurelen + count) + 1024;
+				closure = realloc(closure, closurecap * sizeof(int));
+			}
+			for (uint64_t bits = r[w - lo]; bits; bits &= bits - 1)
+				closure[closurelen++] = w << 6 | __builtin_ctzll(bits);
+		}
+		row[c] = r;
+		rowlo[c] = lo;
+		rowhi[c] = hi;
+		if (users[c] == 0)
+			free(r);
+	}
+	closurestart[numscc] = closurelen;
+
+	free(row);
+	free(rowlo);
+	free(rowhi);
+	free(users);
+}
+
+void printeclose()
+{
+	findeclose();
+	for(int i = 0; i < numstates; i++)
+	{
+		int c = scc[i];
+		printf("e-closure(q%d) = {", i);
+		for(int k = closurestart[c]; k < closurestart[c + 1]; k++)
+			printf(k > closurestart[c] ? ",q%d" : "q%d", closure[k]);
+		printf("}\n");
 	}
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	get_enfa();
+	if (argc > 1)
+	{
+		if (!load_enfa(argv[1]))
+			return 1;
+	}
+	else
+		get_enfa();
 	printeclose();
 	return 0;
 }
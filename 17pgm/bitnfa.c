@@ -0,0 +1,116 @@
+#include <string.h>
+#include "bitnfa.h"
+
+// Fill a table of 256 entries with the OR of the words for the bits of each
+// byte, each entry from one with a bit fewer
+static void fillTable(uint64_t *table, const uint64_t *words, int count) {
+    table[0] = 0;
+    for (int x = 1; x < 256; x++) {
+        int i = __builtin_ctz(x);
+        table[x] = table[x & (x - 1)] | (i < count ? words[i] : 0);
+    }
+}
+
+// Returns 0 if the NFA has more than 64 positions
+int buildBitNfa(BitNfa *b, Nfa *a) {
+    memset(b, 0, sizeof(*b));
+    if (a->n == 0 || a->n > 1 << 30)
+        return 0;
+    if (!a->closure)
+        computeEpsilonClosures(a);
+
+    int n = 0, m = a->m;
+    int *position = malloc((a->n + 1) * sizeof(int));
+    for (int s = 0; s < a->n; s++)
+        position[s] = s == 0 ? 0 : -1;
+    for (long t = 0; t < a->transStart[(long)a->n * m]; t++)
+        position[a->transTo[t]] = 0;
+    b->state = malloc(65 * sizeof(int));
+    for (int s = 0; s < a->n; s++) {
+        if (position[s] < 0)
+            continue;
+        if (n == 64) {
+            free(position);
+            freeBitNfa(b);
+            return 0;
+        }
+        b->state[n] = s;
+        position[s] = n++;
+    }
+
+    // The positions reached from each position with each symbol, through
+    // the states of its closure
+    uint64_t *next = calloc((long)n * m + 1, sizeof(uint64_t));
+    for (int p = 0; p < n; p++) {
+        int c = a->component[b->state[p]];
+        for (int w = a->closureLo[c]; w < a->closureHi[c]; w++) {
+            for (uint64_t bits = a->closure[c][w - a->closureLo[c]]; bits; bits &= bits - 1) {
+                int x = w << 6 | __builtin_ctzll(bits);
+                if (a->final[x])
+                    b->final |= 1ULL << p;
+                for (int j = 0; j < m; j++) {
+                    long row = (long)x * m + j;
+                    for (long t = a->transStart[row]; t < a->transStart[row + 1]; t++)
+                        next[(long)p * m + j] |= 1ULL << position[a->transTo[t]];
+                }
+            }
+        }
+    }
+    free(position);
+
+    uint64_t follow[64] = { 0 };
+    b->n = n;
+    b->m = m;
+    b->start = 1;
+    b->chunks = (n + 7) / 8;
+    b->mask = calloc(m + 1, sizeof(uint64_t));
+    for (int p = 0; p < n; p++) {
+        for (int j = 0; j < m; j++) {
+            follow[p] |= next[(long)p * m + j];
+            b->mask[j] |= next[(long)p * m + j];
+        }
+    }
+
+    b->kind = SHIFT;
+    for (int p = 0; p < n && b->kind != GENERAL; p++) {
+        for (int j = 0; j < m; j++)
+            if (next[(long)p * m + j] != (follow[p] & b->mask[j]))
+                b->kind = GENERAL;
+        uint64_t self = 1ULL << p, after = p < 63 ? 2ULL << p : 0;
+        if (p > 0 && (follow[p] & ~(self | after)))
+            if (b->kind == SHIFT)
+                b->kind = GLUSHKOV;
+    }
+
+    if (b->kind == SHIFT) {
+        b->first = follow[0];
+        for (int p = 1; p < n; p++) {
+            if (follow[p] & (1ULL << p))
+                b->loop |= 1ULL << p;
+            if (p < 63 && (follow[p] & (2ULL << p)))
+                b->forward |= 1ULL << p;
+        }
+    } else if (b->kind == GLUSHKOV) {
+        b->follow = malloc(b->chunks * sizeof(*b->follow));
+        for (int k = 0; k < b->chunks; k++)
+            fillTable(b->follow[k], follow + 8 * k, n - 8 * k);
+    } else {
+        uint64_t words[8];
+        b->follow = malloc((long)m * b->chunks * sizeof(*b->follow));
+        for (int j = 0; j < m; j++) {
+            for (int k = 0; k < b->chunks; k++) {
+                for (int i = 0; i < 8 && 8 * k + i < n; i++)
+                    words[i] = next[(long)(8 * k + i) * m + j];
+                fillTable(b->follow[j * b->chunks + k], words, n - 8 * k);
+            }
+        }
+    }
+    free(next);
+    return 1;
+}
+
+void freeBitNfa(BitNfa *b) {
+    free(b->state);
+    free(b->mask);
+    free(b->follow);
+}
@@ -0,0 +1,54 @@
+#ifndef BITNFA_H
+#define BITNFA_H
+
+#include "nfa.h"
+
+// An NFA of at most 64 positions simulated with its set of active
+// positions in one word. The positions are q0 and the states that moves on
+// symbols lead to, in order of state number; being at a position means being
+// in all of its closure, so epsilon moves disappear and a symbol takes the
+// set straight to the next one.
+//
+// In a Glushkov automaton, which Thompson's construction reduces to, all the
+// moves into a position are on the same symbols, so a step is the positions
+// that follow the set masked by the positions entered on the symbol. When
+// every position but q0 is only followed by itself and the next one, the
+// follow is a shift, as in Shift-And. Otherwise it is looked up a byte of the
+// set at a time.
+enum { SHIFT, GLUSHKOV, GENERAL };
+
+typedef struct {
+    int n, m, kind, chunks;     // chunks: bytes of the set in use
+    int *state;                 // the NFA state of each position
+    uint64_t start, final;      // final: positions whose closure accepts
+    uint64_t *mask;             // mask[j]: the positions entered on symbol j
+
+    // SHIFT: follow(d) = (d & forward) << 1 | (d & loop) | first if q0 is in d
+    uint64_t forward, loop, first;
+
+    // GLUSHKOV: follow[k][b] follows the positions 8k + i for the bits i of
+    // b; GENERAL: follow[j * chunks + k][b] does the same with symbol j
+    uint64_t (*follow)[256];
+} BitNfa;
+
+int buildBitNfa(BitNfa *b, Nfa *a);
+void freeBitNfa(BitNfa *b);
+
+static inline uint64_t bitStep(const BitNfa *b, uint64_t d, int symbol) {
+    uint64_t f = 0;
+    switch (b->kind) {
+    case SHIFT:
+        f = (d & b->forward) << 1 | (d & b->loop) | (-(d & 1) & b->first);
+        return f & b->mask[symbol];
+    case GLUSHKOV:
+        for (int k = 0; k < b->chunks; k++)
+            f |= b->follow[k][d >> 8 * k & 255];
+        return f & b->mask[symbol];
+    default:
+        for (int k = 0; k < b->chunks; k++)
+            f |= b->follow[symbol * b->chunks + k][d >> 8 * k & 255];
+        return f;
+    }
+}
+
+#endif
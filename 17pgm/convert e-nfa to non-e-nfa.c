@@ -1,100 +1,29 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+#include <limits.h>
+#include "nfa.h"
 
-#define MAX_STATES 20
-#define MAX_SYMBOLS 20
+// The NFA is read from the file given, or entered state by state
+int main(int argc, char **argv) {
+    Nfa a;
+    if (!(argc > 1 ? loadNfa(&a, argv[1]) : readNfa(&a, stdin)))
+        return 1;
+    computeEpsilonClosures(&a);
 
-int n, m;
-char symbols[MAX_SYMBOLS];
-int transition[MAX_STATES][MAX_SYMBOLS][MAX_STATES];
-int epsilon[MAX_STATES][MAX_STATES];
-int epsilonClosure[MAX_STATES][MAX_STATES];
-int closureCount[MAX_STATES];
-
-void addToClosure(int state, int s) {
-    if (!epsilonClosure[state][s]) {
-        epsilonClosure[state][s] = 1;
-        closureCount[state]++;
-        for (int t = 0; t < n; t++) {
-            if (epsilon[s][t]) {
-                addToClosure(state, t);
-            }
-        }
-    }
-}
-
-void computeEpsilonClosures() {
-    for (int i = 0; i < n; i++) {
-        memset(epsilonClosure[i], 0, sizeof(epsilonClosure[i]));
-        closureCount[i] = 0;
-        addToClosure(i, i);
-    }
-}
-
-int main() {
-    printf("Enter number of states: ");
-    scanf("%d", &n);
-
-    printf("Enter number of input symbols: (other than epsilon) ");
-    scanf("%d", &m);
-
-    printf("Enter input symbols  (epsilon transitions are entered seperately):\n");
-    for (int i = 0; i < m; i++) {
-        scanf(" %c", &symbols[i]);
-    }
-
-    memset(transition, 0, sizeof(transition));
-    memset(epsilon, 0, sizeof(epsilon));
-
-    int num;
-    printf("Enter transition table (for each state and symbol)\n");
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < m; j++) {
-            printf("From state q%d with symbol %c:\nNumber of next states: ", i, symbols[j]);
-            scanf("%d", &num);
-            if(num)
-                printf("Enter next states(only state numbers, q not needed)\n");
-            for (int k = 0; k < num; k++) {
-                int s;
-		printf("Next state: ");
-                scanf("%d", &s);
-                transition[i][j][s] = 1;
-            }
-        }
-    }
-
-    printf("Enter epsilon transitions (from_state_number  to_state_number, -1 -1 to stop):\n");
-    while (1) {
-        int a, b;
-        scanf("%d %d", &a, &b);
-        if (a == -1 && b == -1) break;
-        epsilon[a][b] = 1;
-    }
-
-    computeEpsilonClosures();
+    // The states reached from state i with symbol j are the closures of the
+    // next states of the states in the closure of i. Only the words of result
+    // touched are printed and cleared.
+    uint64_t *result = calloc((a.n + 63) / 64 + 1, sizeof(uint64_t));
 
     printf("Equivalent NFA without epsilon moves:\n");
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < m; j++) {
-            int result[MAX_STATES] = {0};
-
-            for (int k = 0; k < n; k++) {
-                if (epsilonClosure[i][k]) {
-                    for (int l = 0; l < n; l++) {
-                        if (transition[k][j][l]) {
-                             for (int p = 0; p < n; p++) {
-                                if (epsilonClosure[l][p]) {
-                                    result[p] = 1;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            printf("From state q%d with symbol %c -> { ", i, symbols[j]);
-            for (int x = 0; x < n; x++) {
-                if (result[x]) printf("q%d ", x);
+    for (int i = 0; i < a.n; i++) {
+        int c = a.component[i];
+        for (int j = 0; j < a.m; j++) {
+            int lo = INT_MAX, hi = 0;
+            step(&a, a.closure[c], a.closureLo[c], a.closureHi[c], j, result, &lo, &hi);
+            printf("From state q%d with symbol %c -> { ", i, a.symbols[j]);
+            for (int x = lo; x < hi; x++) {
+                for (uint64_t bits = result[x]; bits; bits &= bits - 1)
+                    printf("q%d ", x << 6 | __builtin_ctzll(bits));
+                result[x] = 0;
             }
             printf("}\n");
         }
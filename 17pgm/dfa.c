@@ -0,0 +1,291 @@
+#include <string.h>
+#include <limits.h>
+#include "dfa.h"
+
+// FNV-1a over the words of a set, which start with word lo
+static unsigned hashSet(const uint64_t *words, int lo, int hi) {
+    uint64_t h = 14695981039346656037ULL ^ (unsigned)lo;
+    for (int w = 0; w < hi - lo; w++)
+        h = (h ^ words[w]) * 1099511628211ULL;
+    return (unsigned)(h ^ h >> 32);
+}
+
+static void growTable(Dfa *d) {
+    d->tableSize = d->tableSize ? 2 * d->tableSize : 1024;
+    free(d->table);
+    d->table = malloc(d->tableSize * sizeof(int));
+    memset(d->table, -1, d->tableSize * sizeof(int));
+    for (int s = 0; s < d->count; s++) {
+        unsigned h = hashSet(d->pool + d->offset[s], d->lo[s], d->hi[s]);
+        while (d->table[h & (d->tableSize - 1)] >= 0)
+            h++;
+        d->table[h & (d->tableSize - 1)] = s;
+    }
+}
+
+// The state for the set in words lo to hi - 1 of set, which are cleared.
+// A new state is added if the set hasn't been seen, or -1 is returned if
+// that would go over the limit.
+int findState(Dfa *d, Nfa *a, uint64_t *set, int lo, int hi) {
+    while (lo < hi && set[lo] == 0)
+        lo++;
+    while (hi > lo && set[hi - 1] == 0)
+        hi--;
+    if (lo == hi)
+        lo = hi = 0;
+
+    unsigned h = hashSet(set + lo, lo, hi);
+    int s;
+    for (;; h++) {
+        s = d->table[h & (d->tableSize - 1)];
+        if (s < 0)
+            break;
+        if (d->lo[s] == lo && d->hi[s] == hi
+            && (hi == lo || memcmp(d->pool + d->offset[s], set + lo, (hi - lo) * sizeof(uint64_t)) == 0))
+            goto found;
+    }
+    if (d->limit && d->count == d->limit) {
+        s = -1;
+        goto found;
+    }
+
+    if (d->count == d->cap) {
+        d->cap = d->cap ? 2 * d->cap : 1024;
+        d->offset = realloc(d->offset, d->cap * sizeof(long));
+        d->lo = realloc(d->lo, d->cap * sizeof(int));
+        d->hi = realloc(d->hi, d->cap * sizeof(int));
+        d->accepting = realloc(d->accepting, d->cap);
+        d->trans = realloc(d->trans, (long)d->cap * d->m * sizeof(int));
+    }
+    if (d->poolLen + hi - lo > d->poolCap) {
+        d->poolCap = 2 * (d->poolLen + hi - lo) + 1024;
+        d->pool = realloc(d->pool, d->poolCap * sizeof(uint64_t));
+    }
+    s = d->count++;
+    d->offset[s] = d->poolLen;
+    d->lo[s] = lo;
+    d->hi[s] = hi;
+    if (hi > lo)   // the pool is still NULL if the empty set comes first
+        memcpy(d->pool + d->poolLen, set + lo, (hi - lo) * sizeof(uint64_t));
+    d->poolLen += hi - lo;
+    d->accepting[s] = 0;
+    for (int w = lo; w < hi; w++)
+        for (uint64_t bits = set[w]; bits && !d->accepting[s]; bits &= bits - 1)
+            d->accepting[s] = a->final[w << 6 | __builtin_ctzll(bits)];
+    d->table[h & (d->tableSize - 1)] = s;
+    if (2 * d->count > d->tableSize)
+        growTable(d);
+
+found:
+    memset(set + lo, 0, (hi - lo) * sizeof(uint64_t));
+    return s;
+}
+
+void initDfa(Dfa *d, int m, int limit) {
+    memset(d, 0, sizeof(*d));
+    d->m = m;
+    d->limit = limit;
+    growTable(d);
+}
+
+// Forget every state, keeping the memory
+void clearDfa(Dfa *d) {
+    d->count = 0;
+    d->poolLen = 0;
+    memset(d->table, -1, d->tableSize * sizeof(int));
+}
+
+// Subset construction from the closure of q0. The states are numbered in the
+// order they are found and handled in that order, so the states still to do
+// are always the ones after s. Returns 0 if the limit was reached.
+int buildDfa(Dfa *d, Nfa *a, int limit) {
+    initDfa(d, a->m, limit);
+    computeEpsilonClosures(a);
+
+    uint64_t *set = calloc((a->n + 63) / 64 + 1, sizeof(uint64_t));
+    if (a->n > 0) {
+        int c = a->component[0];
+        memcpy(set + a->closureLo[c], a->closure[c], (a->closureHi[c] - a->closureLo[c]) * sizeof(uint64_t));
+        findState(d, a, set, a->closureLo[c], a->closureHi[c]);
+    } else {
+        findState(d, a, set, 0, 0);
+    }
+
+    for (int s = 0; s < d->count; s++) {
+        for (int j = 0; j < d->m; j++) {
+            int lo = INT_MAX, hi = 0;
+            step(a, d->pool + d->offset[s], d->lo[s], d->hi[s], j, set, &lo, &hi);
+            if (lo > hi)
+                lo = hi = 0;
+            int t = findState(d, a, set, lo, hi);
+            if (t < 0) {
+                free(set);
+                return 0;
+            }
+            d->trans[(long)s * d->m + j] = t;
+        }
+    }
+    free(set);
+    return 1;
+}
+
+void freeDfa(Dfa *d) {
+    free(d->offset);
+    free(d->lo);
+    free(d->hi);
+    free(d->accepting);
+    free(d->trans);
+    free(d->pool);
+    free(d->table);
+}
+
+// Hopcroft's partition refinement. The states of each block are kept
+// together in elems, from first[b] to end[b] - 1, with the states marked
+// while splitting moved to the front. When a block splits, the smaller part
+// becomes the new block, so its states are the only ones relabelled and
+// (new block, symbol) is always the right splitter to add, whether or not
+// the old block was still waiting: each state is relabelled and used as a
+// splitter O(log n) times. Returns the number of blocks, with the block of
+// each state in block.
+int minimise(Dfa *d, int *block) {
+    int n = d->count, m = d->m;
+    long rows = (long)n * m;
+
+    // The states moving into state t with symbol j are
+    // from[start[j * n + t]] up to from[start[j * n + t + 1] - 1]
+    long *start = calloc(rows + 1, sizeof(long));
+    int *from = malloc((rows + 1) * sizeof(int));
+    for (int s = 0; s < n; s++)
+        for (int j = 0; j < m; j++)
+            start[(long)j * n + d->trans[(long)s * m + j] + 1]++;
+    for (long r = 0; r < rows; r++)
+        start[r + 1] += start[r];
+    for (int s = 0; s < n; s++)
+        for (int j = 0; j < m; j++)
+            from[start[(long)j * n + d->trans[(long)s * m + j]]++] = s;
+    for (long r = rows; r > 0; r--)
+        start[r] = start[r - 1];
+    start[0] = 0;
+
+    int *elems = malloc((n + 1) * sizeof(int)), *where = malloc((n + 1) * sizeof(int));
+    int *first = malloc((n + 1) * sizeof(int)), *end = malloc((n + 1) * sizeof(int));
+    int *marked = calloc(n + 1, sizeof(int));
+    int *preds = malloc((n + 1) * sizeof(int)), *touched = malloc((n + 1) * sizeof(int));
+    int *workBlock = malloc((rows + m + 1) * sizeof(int)), *workSymbol = malloc((rows + m + 1) * sizeof(int));
+    int blocks = 0, size = 0, top = 0;
+
+    for (int accept = 1; accept >= 0; accept--) {
+        first[blocks] = size;
+        for (int s = 0; s < n; s++) {
+            if (d->accepting[s] == accept) {
+                block[s] = blocks;
+                where[s] = size;
+                elems[size++] = s;
+            }
+        }
+        end[blocks] = size;
+        if (end[blocks] > first[blocks])
+            blocks++;
+    }
+    if (blocks == 2) {
+        int smaller = end[0] - first[0] <= end[1] - first[1] ? 0 : 1;
+        for (int j = 0; j < m; j++) {
+            workBlock[top] = smaller;
+            workSymbol[top++] = j;
+        }
+    }
+
+    while (top > 0) {
+        int b = workBlock[--top], j = workSymbol[top];
+        int count = 0, touchedCount = 0;
+        for (int k = first[b]; k < end[b]; k++) {
+            long row = (long)j * n + elems[k];
+            for (long e = start[row]; e < start[row + 1]; e++)
+                preds[count++] = from[e];
+        }
+        for (int k = 0; k < count; k++) {
+            int p = preds[k], c = block[p], to = first[c] + marked[c];
+            if (marked[c]++ == 0)
+                touched[touchedCount++] = c;
+            int q = elems[to];
+            elems[to] = p;
+            elems[where[p]] = q;
+            where[q] = where[p];
+            where[p] = to;
+        }
+        for (int k = 0; k < touchedCount; k++) {
+            int c = touched[k], mk = marked[c], len = end[c] - first[c];
+            marked[c] = 0;
+            if (mk == len)
+                continue;
+            int nb = blocks++;
+            if (mk <= len - mk) {
+                first[nb] = first[c];
+                end[nb] = first[c] + mk;
+                first[c] = end[nb];
+            } else {
+                first[nb] = first[c] + mk;
+                end[nb] = end[c];
+                end[c] = first[nb];
+            }
+            for (int x = first[nb]; x < end[nb]; x++)
+                block[elems[x]] = nb;
+            for (int a = 0; a < m; a++) {
+                workBlock[top] = nb;
+                workSymbol[top++] = a;
+            }
+        }
+    }
+
+    free(start);
+    free(from);
+    free(elems);
+    free(where);
+    free(first);
+    free(end);
+    free(marked);
+    free(preds);
+    free(touched);
+    free(workBlock);
+    free(workSymbol);
+    return blocks;
+}
+
+// Replace the DFA by its quotient, numbering the blocks in the order a
+// breadth first search from the start state reaches them
+void quotient(Dfa *d, int *block, int blocks) {
+    int m = d->m;
+    int *number = malloc((blocks + 1) * sizeof(int)), *rep = malloc((blocks + 1) * sizeof(int));
+    int *trans = malloc(((long)blocks * m + 1) * sizeof(int));
+    char *accepting = malloc(blocks + 1);
+    for (int b = 0; b < blocks; b++)
+        number[b] = -1;
+    for (int s = d->count - 1; s >= 0; s--)
+        rep[block[s]] = s;
+
+    int count = 0;
+    int *order = malloc((blocks + 1) * sizeof(int));
+    number[block[0]] = count;
+    order[count++] = block[0];
+    for (int k = 0; k < count; k++) {
+        int s = rep[order[k]];
+        accepting[k] = d->accepting[s];
+        for (int j = 0; j < m; j++) {
+            int b = block[d->trans[(long)s * m + j]];
+            if (number[b] < 0) {
+                number[b] = count;
+                order[count++] = b;
+            }
+            trans[(long)k * m + j] = number[b];
+        }
+    }
+
+    free(d->trans);
+    free(d->accepting);
+    d->trans = trans;
+    d->accepting = accepting;
+    d->count = count;
+    free(number);
+    free(rep);
+    free(order);
+}
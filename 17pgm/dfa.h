@@ -0,0 +1,30 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include "nfa.h"
+
+// A DFA made by subset construction. Each state is the set of NFA states it
+// stands for, a bitset with the zero words at both ends trimmed off: words
+// lo[s] to hi[s] - 1 kept in pool from offset[s]. The empty set is the state
+// with lo = hi = 0.
+typedef struct {
+    int count, cap, m;
+    long *offset;
+    int *lo, *hi;
+    char *accepting;
+    int *trans;                 // trans[s * m + j]: next state with symbol j
+    uint64_t *pool;
+    long poolLen, poolCap;
+    int *table, tableSize;      // open addressing on the sets, -1 when free
+    int limit;                  // most states to build, 0 for no limit
+} Dfa;
+
+void initDfa(Dfa *d, int m, int limit);
+void clearDfa(Dfa *d);
+int findState(Dfa *d, Nfa *a, uint64_t *set, int lo, int hi);
+int buildDfa(Dfa *d, Nfa *a, int limit);
+void freeDfa(Dfa *d);
+int minimise(Dfa *d, int *block);
+void quotient(Dfa *d, int *block, int blocks);
+
+#endif
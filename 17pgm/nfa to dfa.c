@@ -0,0 +1,199 @@
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "dfa.h"
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+
+void printDfa(Dfa *d, Nfa *a) {
+    printf("%-9s", "State");
+    for (int j = 0; j < d->m; j++)
+        printf(" %7c", a->symbols[j]);
+    printf("\n");
+    for (int s = 0; s < d->count; s++) {
+        char name[16];
+        snprintf(name, sizeof(name), "D%d", s);
+        printf("%2s%c %-5s", s == 0 ? "->" : "", d->accepting[s] ? '*' : ' ', name);
+        for (int j = 0; j < d->m; j++) {
+            snprintf(name, sizeof(name), "D%d", d->trans[(long)s * d->m + j]);
+            printf(" %7s", name);
+        }
+        printf("\n");
+    }
+}
+
+// A random NFA over a and b shaped like the NFA of a long regular
+// expression: the even states form a spine that reads any symbol, and now and
+// then start a thread through the odd states, which expect one symbol at each
+// step, die on the other, sometimes skip ahead and sometimes end. Some thread
+// states accept.
+unsigned long long seed = 88172645463325252ULL;
+
+int randomInt(int n) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (int)(seed % n);
+}
+
+void generateNfa(Nfa *a, int n) {
+    initNfa(a, n, 2, "ab");
+    for (int i = 0; i + 2 < n; i += 2) {
+        addMove(a, i, 0, i + 2);
+        addMove(a, i, 1, i + 2);
+        if (randomInt(4) == 0)
+            addMove(a, i, randomInt(2), i + 3);
+        if (randomInt(8) == 0)
+            addMove(a, i, -1, i + 1);
+    }
+    for (int i = 1; i + 4 < n; i += 2) {
+        if (randomInt(4) == 0)
+            continue;
+        int j = randomInt(2);
+        addMove(a, i, j, randomInt(8) ? i + 2 : i + 4);
+        a->final[i] = randomInt(16) == 0;
+    }
+    if (n > 0)
+        a->final[n - 1] = 1;
+    compressNfa(a);
+}
+
+// (a|b)*a(a|b)^k: the DFA has to remember the last k + 1 symbols, so it has
+// 2^(k+1) states against the NFA's k + 2
+void blowUpNfa(Nfa *a, int k) {
+    initNfa(a, k + 2, 2, "ab");
+    addMove(a, 0, 0, 0);
+    addMove(a, 0, 1, 0);
+    addMove(a, 0, 0, 1);
+    for (int i = 1; i <= k; i++) {
+        addMove(a, i, 0, i + 1);
+        addMove(a, i, 1, i + 1);
+    }
+    a->final[k + 1] = 1;
+    compressNfa(a);
+}
+
+// Convert and minimise, reporting the sizes and times on one line. Returns 0
+// if the limit was reached.
+int convert(Nfa *a, Dfa *d, int limit, const char *name) {
+    double t0 = now();
+    int complete = buildDfa(d, a, limit);
+    double t1 = now();
+    if (!complete) {
+        printf("%-22s %9d %9s  %10.1f  stopped at %d states\n", name, a->n, "-", t1 - t0, limit);
+        return 0;
+    }
+    int subsets = d->count;
+    long words = d->poolLen;
+    int *block = malloc((d->count + 1) * sizeof(int));
+    int blocks = minimise(d, block);
+    quotient(d, block, blocks);
+    free(block);
+    double t2 = now();
+    printf("%-22s %9d %9d  %10.1f  %9d  %10.1f  %8.1f\n", name, a->n, subsets, t1 - t0,
+           d->count, t2 - t1, words * 8 / 1048576.0);
+    return 1;
+}
+
+void benchmark(int limit) {
+    printf("%-22s %9s %9s  %10s  %9s  %10s  %8s\n", "NFA", "states", "subsets", "build ms",
+           "minimal", "min ms", "sets MB");
+    char name[64];
+    for (int n = 1000; n <= 1000000; n *= 10) {
+        Nfa a;
+        Dfa d;
+        seed = 88172645463325252ULL;
+        generateNfa(&a, n);
+        snprintf(name, sizeof(name), "random %d", n);
+        convert(&a, &d, limit, name);
+        freeDfa(&d);
+        freeNfa(&a);
+    }
+    for (int k = 4; k <= 20; k += 4) {
+        Nfa a;
+        Dfa d;
+        blowUpNfa(&a, k);
+        snprintf(name, sizeof(name), "(a|b)*a(a|b)^%d", k);
+        convert(&a, &d, limit, name);
+        freeDfa(&d);
+        freeNfa(&a);
+    }
+}
+
+int main(int argc, char **argv) {
+    int limit = 0, generate = 0, quiet = 0, bench = 0, opt;
+    const char *path = NULL, *output = NULL;
+    while ((opt = getopt(argc, argv, "c:g:f:w:bq")) != -1) {
+        switch (opt) {
+        case 'c':
+            limit = atoi(optarg);
+            break;
+        case 'g':
+            generate = atoi(optarg);
+            break;
+        case 'f':
+            path = optarg;
+            break;
+        case 'w':
+            output = optarg;
+            break;
+        case 'b':
+            bench = 1;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c most states] [-g states | -f file] [-w file] [-q] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (bench) {
+        benchmark(limit);
+        return 0;
+    }
+
+    Nfa a;
+    Dfa d;
+    double loading = now();
+    if (generate > 0) {
+        generateNfa(&a, generate);
+    } else if (path) {
+        if (!loadNfa(&a, path))
+            return 1;
+        fprintf(stderr, "%s: %ld moves loaded in %.1f ms\n", path,
+                a.transStart[(long)a.n * a.m] + a.epsStart[a.n], now() - loading);
+    } else {
+        if (!readNfa(&a, stdin))
+            return 1;
+        readFinalStates(&a, stdin);
+    }
+    if (output && !saveNfa(&a, output))
+        return 1;
+
+    double t0 = now();
+    if (!buildDfa(&d, &a, limit)) {
+        fprintf(stderr, "subset construction stopped at %d states\n", limit);
+        return 2;
+    }
+    double t1 = now();
+    int subsets = d.count;
+    int *block = malloc((d.count + 1) * sizeof(int));
+    int blocks = minimise(&d, block);
+    quotient(&d, block, blocks);
+    double t2 = now();
+
+    if (!quiet) {
+        printf("Minimal DFA (start ->, accepting *):\n");
+        printDfa(&d, &a);
+    }
+    fprintf(stderr, "%d NFA states, %d subsets in %.1f ms, %d states after minimising in %.1f ms\n",
+            a.n, subsets, t1 - t0, d.count, t2 - t1);
+    return 0;
+}
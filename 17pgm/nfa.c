@@ -0,0 +1,545 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "nfa.h"
+
+void initNfa(Nfa *a, int n, int m, const char *symbols) {
+    memset(a, 0, sizeof(*a));
+    a->n = n;
+    a->m = m;
+    a->symbols = malloc(m + 1);
+    memcpy(a->symbols, symbols, m);
+    a->symbols[m] = '\0';
+    a->final = calloc(n + 1, 1);
+}
+
+void addMove(Nfa *a, int from, int symbol, int to) {
+    if (a->edgeCount == a->edgeCap) {
+        a->edgeCap = a->edgeCap ? 2 * a->edgeCap : 1024;
+        a->edgeFrom = realloc(a->edgeFrom, a->edgeCap * sizeof(int));
+        a->edgeSymbol = realloc(a->edgeSymbol, a->edgeCap * sizeof(int));
+        a->edgeTo = realloc(a->edgeTo, a->edgeCap * sizeof(int));
+    }
+    a->edgeFrom[a->edgeCount] = from;
+    a->edgeSymbol[a->edgeCount] = symbol;
+    a->edgeTo[a->edgeCount++] = to;
+}
+
+void freeNfa(Nfa *a) {
+    free(a->edgeFrom);
+    free(a->edgeSymbol);
+    free(a->edgeTo);
+    free(a->symbols);
+    free(a->final);
+    free(a->transStart);
+    free(a->transTo);
+    free(a->epsStart);
+    free(a->epsTo);
+    for (int c = 0; c < a->componentCount; c++)
+        free(a->closure[c]);
+    free(a->closure);
+    free(a->closureLo);
+    free(a->closureHi);
+    free(a->component);
+    free(a->seen);
+}
+
+// Sort the moves into the compressed rows, keeping the order they were added in
+void compressNfa(Nfa *a) {
+    long rows = (long)a->n * a->m;
+    a->transStart = calloc(rows + 1, sizeof(long));
+    a->epsStart = calloc(a->n + 1, sizeof(int));
+    for (long e = 0; e < a->edgeCount; e++) {
+        if (a->edgeSymbol[e] < 0)
+            a->epsStart[a->edgeFrom[e] + 1]++;
+        else
+            a->transStart[(long)a->edgeFrom[e] * a->m + a->edgeSymbol[e] + 1]++;
+    }
+    for (long r = 0; r < rows; r++)
+        a->transStart[r + 1] += a->transStart[r];
+    for (int i = 0; i < a->n; i++)
+        a->epsStart[i + 1] += a->epsStart[i];
+
+    a->transTo = malloc((a->transStart[rows] + 1) * sizeof(int));
+    a->epsTo = malloc((a->epsStart[a->n] + 1) * sizeof(int));
+    for (long e = 0; e < a->edgeCount; e++) {
+        if (a->edgeSymbol[e] < 0)
+            a->epsTo[a->epsStart[a->edgeFrom[e]]++] = a->edgeTo[e];
+        else
+            a->transTo[a->transStart[(long)a->edgeFrom[e] * a->m + a->edgeSymbol[e]]++] = a->edgeTo[e];
+    }
+    for (long r = rows; r > 0; r--)
+        a->transStart[r] = a->transStart[r - 1];
+    a->transStart[0] = 0;
+    for (int i = a->n; i > 0; i--)
+        a->epsStart[i] = a->epsStart[i - 1];
+    a->epsStart[0] = 0;
+
+    free(a->edgeFrom);
+    free(a->edgeSymbol);
+    free(a->edgeTo);
+    a->edgeFrom = a->edgeSymbol = a->edgeTo = NULL;
+    a->edgeCount = a->edgeCap = 0;
+}
+
+// Read the states, the symbols, the next states of every state with every
+// symbol, and the epsilon moves up to -1 -1. Prompts are printed when reading
+// from a terminal. Returns 0 if the sizes can't be read or there is no q0.
+int readNfa(Nfa *a, FILE *in) {
+    int interactive = isatty(fileno(in));
+    int n = 0, m = 0;
+    if (interactive)
+        printf("Enter number of states: ");
+    if (fscanf(in, "%d", &n) != 1 || n < 1)
+        return 0;
+
+    if (interactive)
+        printf("Enter number of input symbols: (other than epsilon) ");
+    if (fscanf(in, "%d", &m) != 1 || m < 0)
+        return 0;
+
+    char *symbols = malloc(m + 1);
+    if (interactive)
+        printf("Enter input symbols  (epsilon transitions are entered seperately):\n");
+    for (int i = 0; i < m; i++) {
+        if (fscanf(in, " %c", &symbols[i]) != 1)
+            symbols[i] = '?';
+    }
+    initNfa(a, n, m, symbols);
+    free(symbols);
+
+    int num;
+    if (interactive)
+        printf("Enter transition table (for each state and symbol)\n");
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            if (interactive)
+                printf("From state q%d with symbol %c:\nNumber of next states: ", i, a->symbols[j]);
+            if (fscanf(in, "%d", &num) != 1)
+                num = 0;
+            if(num && interactive)
+                printf("Enter next states(only state numbers, q not needed)\n");
+            for (int k = 0; k < num; k++) {
+                int s;
+                if (interactive)
+                    printf("Next state: ");
+                if (fscanf(in, "%d", &s) == 1 && s >= 0 && s < n)
+                    addMove(a, i, j, s);
+                else
+                    fprintf(stderr, "q%d with %c: no such next state\n", i, a->symbols[j]);
+            }
+        }
+    }
+
+    if (interactive)
+        printf("Enter epsilon transitions (from_state_number  to_state_number, -1 -1 to stop):\n");
+    while (1) {
+        int from, to;
+        if (fscanf(in, "%d %d", &from, &to) != 2) break;
+        if (from == -1 && to == -1) break;
+        if (from >= 0 && from < n && to >= 0 && to < n)
+            addMove(a, from, -1, to);
+        else
+            fprintf(stderr, "%d %d: no such state\n", from, to);
+    }
+    compressNfa(a);
+    return 1;
+}
+
+// Read the accepting states up to -1
+void readFinalStates(Nfa *a, FILE *in) {
+    int s;
+    if (isatty(fileno(in)))
+        printf("Enter final states (only state numbers, -1 to stop):\n");
+    while (fscanf(in, "%d", &s) == 1 && s != -1) {
+        if (s >= 0 && s < a->n)
+            a->final[s] = 1;
+        else
+            fprintf(stderr, "%d: no such state\n", s);
+    }
+}
+
+// The text format is parsed by hand from the whole file in memory, since
+// fscanf would take longer than everything else in loading put together
+static const char *skipSpace(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        p++;
+    return p;
+}
+
+static const char *readState(const char **p, long n, long *state) {
+    const char *q = skipSpace(*p);
+    long v = 0;
+    if (*q < '0' || *q > '9')
+        return "expected a state";
+    while (*q >= '0' && *q <= '9' && v < n)
+        v = v * 10 + (*q++ - '0');
+    if (v >= n)
+        return "no such state";
+    *p = q;
+    *state = v;
+    return NULL;
+}
+
+// The line nfa <states> <symbols> that starts the file
+static const char *readHeader(Nfa *a, const char **p, long *n, int *symbolOf) {
+    const char *q = *p + 3, *symbols;
+    long states;
+    if (strncmp(*p, "nfa", 3) != 0 || readState(&q, INT32_MAX, &states))
+        return "expected nfa and the number of states";
+    if (states == 0)
+        return "no states, not even q0";
+    *n = states;
+    symbols = q = skipSpace(q);
+    while (*q > ' ' && symbolOf[(unsigned char)*q] == -2) {
+        symbolOf[(unsigned char)*q] = q - symbols;
+        q++;
+    }
+    initNfa(a, *n, q - symbols, symbols);
+    *p = q;
+    return NULL;
+}
+
+static int loadText(Nfa *a, const char *p, const char *path) {
+    int symbolOf[256];
+    long line = 0, n = -1, from, to;
+    const char *error = NULL;
+    for (int c = 0; c < 256; c++)
+        symbolOf[c] = -2;
+    symbolOf['#'] = -1;
+
+    while (*p && !error) {
+        const char *q = skipSpace(p);
+        line++;
+        if (*q == '#' || *q == '\n' || !*q) {
+            // a comment or a blank line
+        } else if (n < 0) {
+            error = readHeader(a, &q, &n, symbolOf);
+        } else if (*q == '*') {
+            for (q = skipSpace(q + 1); !error && *q >= '0' && *q <= '9'; q = skipSpace(q))
+                if (!(error = readState(&q, n, &to)))
+                    a->final[to] = 1;
+        } else if (!(error = readState(&q, n, &from))) {
+            q = skipSpace(q);
+            int symbol = symbolOf[(unsigned char)*q++];
+            if (symbol == -2)
+                error = "no such symbol";
+            else if (!(error = readState(&q, n, &to)))
+                addMove(a, from, symbol, to);
+        }
+        if (!error) {
+            q = skipSpace(q);
+            if (*q == '#')
+                while (*q && *q != '\n')
+                    q++;
+            if (*q && *q != '\n')
+                error = "unexpected text";
+            p = q + (*q == '\n');
+        }
+    }
+    if (!error && n < 0)
+        error = "no nfa line";
+    if (error) {
+        fprintf(stderr, "%s:%ld: %s\n", path, line, error);
+        if (n >= 0)
+            freeNfa(a);
+        return 0;
+    }
+    compressNfa(a);
+    return 1;
+}
+
+// The binary format is read straight into the compressed rows, converting
+// only the row lengths to starts. A word of the file that is a state is
+// checked by collecting a flag for the whole array, so the loop has no branch.
+static int readWords(uint32_t *to, long count, long n, FILE *in) {
+    uint32_t bad = 0;
+    if (fread(to, sizeof(uint32_t), count, in) != (size_t)count)
+        return 0;
+    for (long i = 0; i < count; i++)
+        bad |= to[i] >= n;
+    return !bad;
+}
+
+static int loadBinary(Nfa *a, FILE *in, const char *path) {
+    uint32_t size[3];
+    uint64_t moves[2];
+    char symbols[260] = "";
+    struct stat st;
+    if (fread(size, sizeof(uint32_t), 3, in) != 3 || fread(moves, sizeof(uint64_t), 2, in) != 2
+        || size[0] == 0 || size[0] > INT32_MAX || size[1] > 256 || size[2] > size[0]
+        || moves[0] > INT64_MAX / 8 || moves[1] > INT32_MAX
+        || fread(symbols, 1, (size[1] + 3) & ~3, in) != ((size[1] + 3) & ~3)) {
+        fprintf(stderr, "%s: bad header\n", path);
+        return 0;
+    }
+    int n = size[0], m = size[1];
+    long rows = (long)n * m, most = rows > n ? rows : n;
+    uint64_t words = size[2] + rows + moves[0] + n + moves[1];
+    if (fstat(fileno(in), &st) != 0 || (uint64_t)st.st_size != 32 + ((m + 3) & ~3) + 4 * words) {
+        fprintf(stderr, "%s: not the size its header gives\n", path);
+        return 0;
+    }
+    uint32_t *length = malloc((most + 1) * sizeof(uint32_t));
+    int ok = readWords(length, size[2], n, in);
+    initNfa(a, n, m, symbols);
+    for (long f = 0; ok && f < size[2]; f++)
+        a->final[length[f]] = 1;
+
+    a->transStart = malloc((rows + 1) * sizeof(long));
+    a->transTo = malloc((moves[0] + 1) * sizeof(int));
+    ok = ok && fread(length, sizeof(uint32_t), rows, in) == (size_t)rows;
+    a->transStart[0] = 0;
+    for (long r = 0; ok && r < rows; r++)
+        a->transStart[r + 1] = a->transStart[r] + length[r];
+    ok = ok && (uint64_t)a->transStart[rows] == moves[0]
+         && readWords((uint32_t *)a->transTo, moves[0], n, in);
+
+    a->epsStart = malloc((n + 1) * sizeof(int));
+    a->epsTo = malloc((moves[1] + 1) * sizeof(int));
+    ok = ok && fread(length, sizeof(uint32_t), n, in) == (size_t)n;
+    long total = 0;
+    a->epsStart[0] = 0;
+    for (int i = 0; ok && i < n; i++) {
+        total += length[i];
+        a->epsStart[i + 1] = total;
+    }
+    ok = ok && (uint64_t)total == moves[1] && readWords((uint32_t *)a->epsTo, moves[1], n, in);
+    free(length);
+    if (!ok) {
+        fprintf(stderr, "%s: a state out of range\n", path);
+        freeNfa(a);
+    }
+    return ok;
+}
+
+int loadNfa(Nfa *a, const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 0;
+    }
+    char magic[4] = "";
+    int ok;
+    if (fread(magic, 1, 4, in) == 4 && memcmp(magic, "NFA\1", 4) == 0) {
+        ok = loadBinary(a, in, path);
+    } else {
+        struct stat st;
+        size_t len = 0, cap = fstat(fileno(in), &st) == 0 && st.st_size > 0 ? st.st_size : 1 << 16, got;
+        char *text = malloc(cap + 1);
+        rewind(in);
+        while ((got = fread(text + len, 1, cap - len, in)) > 0) {
+            len += got;
+            if (len == cap)
+                text = realloc(text, (cap *= 2) + 1);
+        }
+        text[len] = '\0';
+        ok = loadText(a, text, path);
+        free(text);
+    }
+    fclose(in);
+    return ok;
+}
+
+// Written in the binary format if the name ends in .nfab, in text otherwise.
+// The NFA has to be compressed.
+int saveNfa(Nfa *a, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        return 0;
+    }
+    long rows = (long)a->n * a->m;
+    size_t len = strlen(path);
+    if (len >= 5 && strcmp(path + len - 5, ".nfab") == 0) {
+        long most = rows > a->n ? rows : a->n;
+        uint32_t *word = malloc((most + 1) * sizeof(uint32_t));
+        uint32_t size[3] = { a->n, a->m, 0 };
+        uint64_t moves[2] = { a->transStart[rows], a->epsStart[a->n] };
+        char symbols[260] = "";
+        memcpy(symbols, a->symbols, a->m);
+        for (int i = 0; i < a->n; i++)
+            if (a->final[i])
+                word[size[2]++] = i;
+        fwrite("NFA\1", 1, 4, out);
+        fwrite(size, sizeof(uint32_t), 3, out);
+        fwrite(moves, sizeof(uint64_t), 2, out);
+        fwrite(symbols, 1, (a->m + 3) & ~3, out);
+        fwrite(word, sizeof(uint32_t), size[2], out);
+        for (long r = 0; r < rows; r++)
+            word[r] = a->transStart[r + 1] - a->transStart[r];
+        fwrite(word, sizeof(uint32_t), rows, out);
+        fwrite(a->transTo, sizeof(int), moves[0], out);
+        for (int i = 0; i < a->n; i++)
+            word[i] = a->epsStart[i + 1] - a->epsStart[i];
+        fwrite(word, sizeof(uint32_t), a->n, out);
+        fwrite(a->epsTo, sizeof(int), moves[1], out);
+        free(word);
+    } else {
+        fprintf(out, "nfa %d %s\n", a->n, a->symbols);
+        for (int i = 0; i < a->n; i++)
+            if (a->final[i])
+                fprintf(out, "* %d\n", i);
+        for (int i = 0; i < a->n; i++) {
+            for (int j = 0; j < a->m; j++) {
+                long row = (long)i * a->m + j;
+                for (long t = a->transStart[row]; t < a->transStart[row + 1]; t++)
+                    fprintf(out, "%d %c %d\n", i, a->symbols[j], a->transTo[t]);
+            }
+            for (int e = a->epsStart[i]; e < a->epsStart[i + 1]; e++)
+                fprintf(out, "%d # %d\n", i, a->epsTo[e]);
+        }
+    }
+    if (fclose(out) != 0) {
+        perror(path);
+        return 0;
+    }
+    return 1;
+}
+
+// Tarjan's algorithm with an explicit stack, so long chains of epsilon moves
+// can't overflow the call stack
+static void findComponents(Nfa *a) {
+    int n = a->n;
+    int *index = malloc((n + 1) * sizeof(int)), *low = malloc((n + 1) * sizeof(int));
+    int *stack = malloc((n + 1) * sizeof(int)), *calls = malloc((n + 1) * sizeof(int));
+    int *next = malloc((n + 1) * sizeof(int));
+    char *onStack = calloc(n + 1, 1);
+    int counter = 0, top = 0;
+
+    a->component = malloc((n + 1) * sizeof(int));
+    a->componentCount = 0;
+    for (int i = 0; i < n; i++)
+        index[i] = -1;
+
+    for (int s = 0; s < n; s++) {
+        if (index[s] >= 0)
+            continue;
+        int depth = 0;
+        calls[depth++] = s;
+        index[s] = low[s] = counter++;
+        next[s] = a->epsStart[s];
+        stack[top++] = s;
+        onStack[s] = 1;
+        while (depth > 0) {
+            int v = calls[depth - 1];
+            if (next[v] < a->epsStart[v + 1]) {
+                int w = a->epsTo[next[v]++];
+                if (index[w] < 0) {
+                    index[w] = low[w] = counter++;
+                    next[w] = a->epsStart[w];
+                    stack[top++] = w;
+                    onStack[w] = 1;
+                    calls[depth++] = w;
+                } else if (onStack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+            if (--depth > 0 && low[v] < low[calls[depth - 1]])
+                low[calls[depth - 1]] = low[v];
+            if (low[v] == index[v]) {
+                int w;
+                do {
+                    w = stack[--top];
+                    onStack[w] = 0;
+                    a->component[w] = a->componentCount;
+                } while (w != v);
+                a->componentCount++;
+            }
+        }
+    }
+    free(index);
+    free(low);
+    free(stack);
+    free(calls);
+    free(next);
+    free(onStack);
+}
+
+// A component's closure is its own states together with the closures of the
+// components its moves lead to, all numbered lower, so one pass in order of
+// number computes every closure by ORing rows word by word.
+void computeEpsilonClosures(Nfa *a) {
+    findComponents(a);
+    int count = a->componentCount;
+    int *memberStart = calloc(count + 1, sizeof(int));
+    int *members = malloc((a->n + 1) * sizeof(int));
+    for (int i = 0; i < a->n; i++)
+        memberStart[a->component[i] + 1]++;
+    for (int c = 0; c < count; c++)
+        memberStart[c + 1] += memberStart[c];
+    for (int i = 0; i < a->n; i++)
+        members[memberStart[a->component[i]]++] = i;
+    for (int c = count; c > 0; c--)
+        memberStart[c] = memberStart[c - 1];
+    memberStart[0] = 0;
+
+    a->closure = malloc((count + 1) * sizeof(uint64_t *));
+    a->closureLo = malloc((count + 1) * sizeof(int));
+    a->closureHi = malloc((count + 1) * sizeof(int));
+    for (int c = 0; c < count; c++) {
+        int lo = members[memberStart[c]] >> 6, hi = lo + 1;
+        for (int k = memberStart[c]; k < memberStart[c + 1]; k++) {
+            int s = members[k];
+            if (s >> 6 < lo)
+                lo = s >> 6;
+            if (s >> 6 >= hi)
+                hi = (s >> 6) + 1;
+            for (int e = a->epsStart[s]; e < a->epsStart[s + 1]; e++) {
+                int d = a->component[a->epsTo[e]];
+                if (d != c && a->closureLo[d] < lo)
+                    lo = a->closureLo[d];
+                if (d != c && a->closureHi[d] > hi)
+                    hi = a->closureHi[d];
+            }
+        }
+        uint64_t *row = calloc(hi - lo, sizeof(uint64_t));
+        for (int k = memberStart[c]; k < memberStart[c + 1]; k++) {
+            int s = members[k];
+            row[(s >> 6) - lo] |= 1ULL << (s & 63);
+            for (int e = a->epsStart[s]; e < a->epsStart[s + 1]; e++) {
+                int d = a->component[a->epsTo[e]];
+                if (d != c)
+                    for (int w = a->closureLo[d]; w < a->closureHi[d]; w++)
+                        row[w - lo] |= a->closure[d][w - a->closureLo[d]];
+            }
+        }
+        a->closure[c] = row;
+        a->closureLo[c] = lo;
+        a->closureHi[c] = hi;
+    }
+    free(memberStart);
+    free(members);
+
+    a->seen = malloc((count + 1) * sizeof(int));
+    for (int c = 0; c < count; c++)
+        a->seen[c] = -1;
+    a->stamp = 0;
+}
+
+// OR into to the closures of the next states with the symbol of the states
+// in from, a bitset stored from word fromLo to fromHi - 1. Each closure is
+// added once; *toLo and *toHi are widened to the words written, which the
+// caller clears. to has a word for every state.
+void step(Nfa *a, const uint64_t *from, int fromLo, int fromHi, int symbol,
+          uint64_t *to, int *toLo, int *toHi) {
+    a->stamp++;
+    for (int w = fromLo; w < fromHi; w++) {
+        for (uint64_t bits = from[w - fromLo]; bits; bits &= bits - 1) {
+            long row = (long)(w << 6 | __builtin_ctzll(bits)) * a->m + symbol;
+            for (long t = a->transStart[row]; t < a->transStart[row + 1]; t++) {
+                int d = a->component[a->transTo[t]];
+                if (a->seen[d] == a->stamp)
+                    continue;
+                a->seen[d] = a->stamp;
+                for (int x = a->closureLo[d]; x < a->closureHi[d]; x++)
+                    to[x] |= a->closure[d][x - a->closureLo[d]];
+                if (a->closureLo[d] < *toLo)
+                    *toLo = a->closureLo[d];
+                if (a->closureHi[d] > *toHi)
+                    *toHi = a->closureHi[d];
+            }
+        }
+    }
+}
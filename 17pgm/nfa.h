@@ -0,0 +1,71 @@
+#ifndef NFA_H
+#define NFA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// An NFA with epsilon moves over states q0 .. q(n-1) and m input symbols,
+// started in q0
+typedef struct {
+    int n, m;
+    char *symbols;
+    char *final;                // 1 for the accepting states
+
+    // Moves as they are added, symbol -1 for epsilon
+    int *edgeFrom, *edgeSymbol, *edgeTo;
+    long edgeCount, edgeCap;
+
+    // Transitions in compressed rows: the next states of state i with symbol
+    // j are transTo[transStart[i * m + j]] up to transTo[transStart[i * m + j + 1] - 1]
+    long *transStart;
+    int *transTo;
+
+    // Epsilon moves, compressed the same way: epsTo[epsStart[i]] onwards
+    int *epsStart, *epsTo;
+
+    // States whose epsilon moves lead to each other have the same closure,
+    // so closures are kept per strongly connected component. Components are
+    // numbered in the order Tarjan's algorithm finds them: moves out of a
+    // component only lead to components with smaller numbers. A closure is a
+    // bitset of 64 bit words, stored only from word closureLo[c] to
+    // closureHi[c] - 1.
+    int *component, componentCount;
+    uint64_t **closure;
+    int *closureLo, *closureHi;
+
+    int *seen, stamp;           // components already added in a step
+} Nfa;
+
+void initNfa(Nfa *a, int n, int m, const char *symbols);
+void addMove(Nfa *a, int from, int symbol, int to);
+void compressNfa(Nfa *a);
+void freeNfa(Nfa *a);
+int readNfa(Nfa *a, FILE *in);
+void readFinalStates(Nfa *a, FILE *in);
+
+// Automata in files, in text or in binary, told apart by the binary magic.
+// The text is a line
+//     nfa <states> <symbols>
+// with at least one state, q0, and the symbols as one word, each character a
+// symbol other than #, then lines of
+//     <from> <symbol> <to>         a move, with # as the symbol of epsilon
+//     * <state> <state> ...        accepting states
+// in any order. A # where a line or a move could start begins a comment, so
+// "0 # 1" is an epsilon move and "0 a 1 # note" a move with a note.
+//
+// The binary format is the compressed rows, so loading is little more than
+// reading arrays. All words are little-endian:
+//     "NFA" 1, then 32 bit n, m and f, then 64 bit symbol and epsilon moves
+//     the m symbols, padded with zeros to a multiple of 4 bytes
+//     32 bit words: f accepting states; n * m row lengths, state by state
+//     and symbol by symbol; the symbol moves' targets in that order; n
+//     epsilon row lengths; the epsilon moves' targets
+// Both loaders print what is wrong with a file and return 0.
+int loadNfa(Nfa *a, const char *path);
+int saveNfa(Nfa *a, const char *path);
+void computeEpsilonClosures(Nfa *a);
+void step(Nfa *a, const uint64_t *from, int fromLo, int fromHi, int symbol,
+          uint64_t *to, int *toLo, int *toHi);
+
+#endif
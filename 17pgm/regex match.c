@@ -0,0 +1,604 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "dfa.h"
+#include "thompson.h"
+#include "bitnfa.h"
+
+// Prints the lines of the input that contain a match of the pattern, like
+// egrep. The NFA is turned into a minimal DFA with a table indexed by byte,
+// unless that takes more than the state limit, in which case (or with -z)
+// the DFA is built lazily, as the input needs its states. With -n the NFA is
+// simulated on bitsets of its states, and with -p on a single word of its
+// positions if it has at most 64.
+enum { FULL, LAZY, SIMULATE, BITS };
+
+// Entries of the lazy table that aren't states
+#define UNKNOWN INT32_MIN
+#define ENDMATCH (INT32_MIN + 1)
+
+typedef struct {
+    Regex re;
+    int engine;
+
+    // The DFA, its states numbered so that the ones after which the rest of
+    // the line can't change the answer, accepting or dead, come from stopFrom
+    // on, and in steps of 256: next[s + byte] is the state after s with the
+    // byte. A newline leads back to start, or to the extra state endMatch if
+    // the line it ends matches at its end. start is the state after the start
+    // of a line.
+    int *next;
+    char *accepting;            // indexed by state / 256
+    int start, stopFrom, endMatch;
+
+    // The lazy DFA uses next and accepting the same way, numbering its
+    // states from start = 0 as they are found. An entry of next is UNKNOWN
+    // until its byte is first met, ~t for a state t that stops the scan, or
+    // ENDMATCH. When the cache is full every state is dropped and the scan
+    // goes on from the current one. accepting is 1 for accepting states, 0
+    // for dead ones and 2 for the rest. useful holds the NFA states from which
+    // the accepting state can be reached without a new line, so a set with
+    // none of them is dead.
+    Dfa lazy;
+    int cache;
+    uint64_t *startSet, *useful;
+    int startLo, startHi;
+    long steps, misses, flushes;
+
+    // The NFA simulation, and the lazy DFA's scratch set
+    uint64_t *current, *following;
+
+    // The bit-parallel simulation, with the positions entered on each byte
+    BitNfa bits;
+    uint64_t byteMask[256];
+} Matcher;
+
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void initLazy(Matcher *mt);
+
+int buildMatcher(Matcher *mt, int engine, int limit, int cache) {
+    Nfa *a = &mt->re.nfa;
+    Dfa d;
+    mt->engine = engine;
+    if (engine == FULL && buildDfa(&d, a, limit)) {
+        int *block = malloc((d.count + 1) * sizeof(int));
+        int blocks = minimise(&d, block);
+        quotient(&d, block, blocks);
+        free(block);
+
+        int n = d.count, m = d.m, count = 0;
+        char *stop = malloc(n + 1);
+        int *number = calloc(n + 1, sizeof(int));
+        for (int s = 0; s < n; s++) {
+            int dead = !d.accepting[s];
+            for (int j = 0; j < m; j++)
+                if (j != mt->re.lineStart && d.trans[(long)s * m + j] != s)
+                    dead = 0;
+            stop[s] = dead || d.accepting[s];
+        }
+        for (int s = 0; s < n; s++)
+            if (!stop[s])
+                number[s] = count++;
+        mt->stopFrom = count << 8;
+        for (int s = 0; s < n; s++)
+            if (stop[s])
+                number[s] = count++;
+        mt->endMatch = count++ << 8;
+        mt->start = number[d.trans[mt->re.lineStart]] << 8;
+
+        mt->next = malloc(((long)count * 256 + 1) * sizeof(int));
+        mt->accepting = malloc(count + 1);
+        for (int s = 0; s < n; s++) {
+            int *row = mt->next + ((long)number[s] << 8);
+            for (int c = 0; c < 256; c++)
+                row[c] = number[d.trans[(long)s * m + mt->re.byteClass[c]]] << 8;
+            row['\n'] = d.accepting[d.trans[(long)s * m + mt->re.lineEnd]] ? mt->endMatch : mt->start;
+            mt->accepting[number[s]] = d.accepting[s];
+        }
+        for (int c = 0; c < 256; c++)
+            mt->next[mt->endMatch + c] = mt->start;
+        mt->accepting[mt->endMatch >> 8] = 1;
+        free(stop);
+        free(number);
+        freeDfa(&d);
+        return n;
+    }
+    if (engine == BITS && buildBitNfa(&mt->bits, a)) {
+        for (int c = 0; c < 256; c++)
+            mt->byteMask[c] = mt->bits.mask[mt->re.byteClass[c]];
+        return mt->bits.n;
+    }
+    if (engine == FULL) {
+        freeDfa(&d);
+        mt->engine = LAZY;
+    } else {
+        if (engine == BITS)
+            mt->engine = SIMULATE;
+        computeEpsilonClosures(a);
+    }
+    mt->current = calloc((a->n + 63) / 64 + 1, sizeof(uint64_t));
+    mt->following = calloc((a->n + 63) / 64 + 1, sizeof(uint64_t));
+    if (mt->engine == LAZY) {
+        mt->cache = cache < 3 ? 3 : cache > 1 << 22 ? 1 << 22 : cache;
+        initLazy(mt);
+    }
+    return 0;
+}
+
+static long report(const unsigned char *from, const unsigned char *to, int count) {
+    if (!count)
+        fwrite(from, 1, to - from + 1, stdout);
+    return 1;
+}
+
+// Run the DFA straight through the lines from p to end, the last of which
+// ends in a newline. Only when it stops is the line around it looked for.
+long scanLines(Matcher *mt, const unsigned char *p, const unsigned char *end, int count) {
+    const int *next = mt->next;
+    int s = mt->start, stopFrom = mt->stopFrom;
+    const unsigned char *line = p;
+    long matches = 0;
+
+    // Every line or none
+    if (s >= stopFrom) {
+        while (mt->accepting[s >> 8] && p < end) {
+            const unsigned char *nl = memchr(p, '\n', end - p);
+            matches += report(p, nl, count);
+            p = nl + 1;
+        }
+        return matches;
+    }
+
+    while (p < end) {
+        while (s < stopFrom && p < end)
+            s = next[s + *p++];
+        if (s < stopFrom)
+            break;
+        const unsigned char *to = s == mt->endMatch ? p - 1 : memchr(p - 1, '\n', end - p + 1);
+        const unsigned char *from = to;
+        while (from > line && from[-1] != '\n')
+            from--;
+        if (mt->accepting[s >> 8])
+            matches += report(from, to, count);
+        p = line = to + 1;
+        s = mt->start;
+    }
+    return matches;
+}
+
+// A state of the lazy DFA for the set in words lo to hi - 1 of current,
+// which are cleared. There must be room for it.
+static int lazyState(Matcher *mt, int lo, int hi) {
+    Dfa *d = &mt->lazy;
+    int count = d->count;
+    int u = findState(d, &mt->re.nfa, mt->current, lo, hi);
+    if (u == count) {
+        int dead = !d->accepting[u];
+        for (int w = d->lo[u]; w < d->hi[u] && dead; w++)
+            if (d->pool[d->offset[u] + w - d->lo[u]] & mt->useful[w])
+                dead = 0;
+        for (int c = 0; c < 256; c++)
+            mt->next[((long)u << 8) + c] = UNKNOWN;
+        mt->accepting[u] = d->accepting[u] ? 1 : dead ? 0 : 2;
+    }
+    return u;
+}
+
+static void addStart(Matcher *mt) {
+    memcpy(mt->current + mt->startLo, mt->startSet, (mt->startHi - mt->startLo) * sizeof(uint64_t));
+    lazyState(mt, mt->startLo, mt->startHi);
+}
+
+static void initLazy(Matcher *mt) {
+    Nfa *a = &mt->re.nfa;
+    int words = (a->n + 63) / 64 + 1;
+
+    // Search back from the accepting state along every move but those on
+    // lineStart, which are kept in compressed rows by the state they reach
+    int *moveStart = calloc(a->n + 2, sizeof(int)), *moveFrom = NULL;
+    int *queue = malloc((a->n + 1) * sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < a->n; i++) {
+            for (int j = 0; j < a->m; j++) {
+                long row = (long)i * a->m + j;
+                for (long t = a->transStart[row]; j != mt->re.lineStart && t < a->transStart[row + 1]; t++) {
+                    if (pass)
+                        moveFrom[moveStart[a->transTo[t]]++] = i;
+                    else
+                        moveStart[a->transTo[t] + 1]++;
+                }
+            }
+            for (int e = a->epsStart[i]; e < a->epsStart[i + 1]; e++) {
+                if (pass)
+                    moveFrom[moveStart[a->epsTo[e]]++] = i;
+                else
+                    moveStart[a->epsTo[e] + 1]++;
+            }
+        }
+        if (pass) {
+            for (int i = a->n; i > 0; i--)
+                moveStart[i] = moveStart[i - 1];
+            moveStart[0] = 0;
+        } else {
+            for (int i = 0; i < a->n; i++)
+                moveStart[i + 1] += moveStart[i];
+            moveFrom = malloc((moveStart[a->n] + 1) * sizeof(int));
+        }
+    }
+    mt->useful = calloc(words, sizeof(uint64_t));
+    int head = 0, tail = 0;
+    queue[tail++] = mt->re.accept;
+    mt->useful[mt->re.accept >> 6] |= 1ULL << (mt->re.accept & 63);
+    while (head < tail) {
+        int v = queue[head++];
+        for (int e = moveStart[v]; e < moveStart[v + 1]; e++) {
+            int u = moveFrom[e];
+            if (!(mt->useful[u >> 6] >> (u & 63) & 1)) {
+                mt->useful[u >> 6] |= 1ULL << (u & 63);
+                queue[tail++] = u;
+            }
+        }
+    }
+    free(moveStart);
+    free(moveFrom);
+    free(queue);
+
+    // The set after the start of a line
+    int c = a->component[0], lo = INT32_MAX, hi = 0;
+    step(a, a->closure[c], a->closureLo[c], a->closureHi[c], mt->re.lineStart, mt->current, &lo, &hi);
+    if (lo > hi)
+        lo = hi = 0;
+    mt->startLo = lo;
+    mt->startHi = hi;
+    mt->startSet = malloc((hi - lo + 1) * sizeof(uint64_t));
+    memcpy(mt->startSet, mt->current + lo, (hi - lo) * sizeof(uint64_t));
+    memset(mt->current + lo, 0, (hi - lo) * sizeof(uint64_t));
+
+    initDfa(&mt->lazy, a->m, mt->cache);
+    mt->next = malloc((long)mt->cache * 256 * sizeof(int));
+    mt->accepting = malloc(mt->cache);
+    addStart(mt);
+}
+
+// The entry of the lazy table for state *s and byte c, from the NFA. If the
+// cache is full it is flushed first, keeping only start and *s, which is
+// renumbered.
+static int lazyStep(Matcher *mt, int *s, int c) {
+    Dfa *d = &mt->lazy;
+    Nfa *a = &mt->re.nfa;
+    int u = *s >> 8, lo = INT32_MAX, hi = 0;
+    mt->misses++;
+    if (d->count == d->limit) {
+        mt->flushes++;
+        memcpy(mt->following, d->pool + d->offset[u], (d->hi[u] - d->lo[u]) * sizeof(uint64_t));
+        lo = d->lo[u];
+        hi = d->hi[u];
+        clearDfa(d);
+        addStart(mt);
+        memcpy(mt->current + lo, mt->following, (hi - lo) * sizeof(uint64_t));
+        u = lazyState(mt, lo, hi);
+        *s = u << 8;
+        lo = INT32_MAX;
+        hi = 0;
+    }
+
+    int symbol = c == '\n' ? mt->re.lineEnd : mt->re.byteClass[c];
+    step(a, d->pool + d->offset[u], d->lo[u], d->hi[u], symbol, mt->current, &lo, &hi);
+    if (lo > hi)
+        lo = hi = 0;
+    if (c == '\n') {
+        int matched = mt->current[mt->re.accept >> 6] >> (mt->re.accept & 63) & 1;
+        memset(mt->current + lo, 0, (hi - lo) * sizeof(uint64_t));
+        return matched ? ENDMATCH : 0;
+    }
+    int t = lazyState(mt, lo, hi);
+    return mt->accepting[t] != 2 ? ~(t << 8) : t << 8;
+}
+
+// As scanLines, filling in the table as it goes
+long lazyLines(Matcher *mt, const unsigned char *p, const unsigned char *end, int count) {
+    int s = 0;
+    const unsigned char *line = p;
+    long matches = 0;
+
+    if (mt->accepting[0] != 2) {
+        while (mt->accepting[0] && p < end) {
+            const unsigned char *nl = memchr(p, '\n', end - p);
+            matches += report(p, nl, count);
+            p = nl + 1;
+        }
+        return matches;
+    }
+
+    while (p < end) {
+        const unsigned char *from = p;
+        int *next = mt->next, t = 0;
+        while (p < end && (t = next[s + *p]) >= 0) {
+            s = t;
+            p++;
+        }
+        mt->steps += p - from;
+        if (p == end)
+            break;
+        if (t == UNKNOWN) {
+            t = lazyStep(mt, &s, *p);
+            mt->next[s + *p] = t;
+            continue;
+        }
+        p++;
+        mt->steps++;
+        const unsigned char *to = t == ENDMATCH ? p - 1 : memchr(p - 1, '\n', end - p + 1);
+        from = to;
+        while (from > line && from[-1] != '\n')
+            from--;
+        if (t == ENDMATCH || mt->accepting[~t >> 8] == 1)
+            matches += report(from, to, count);
+        p = line = to + 1;
+        s = 0;
+    }
+    return matches;
+}
+
+// The NFA's sets are bitsets over all its states, of which only the words
+// from lo to hi - 1 can be nonzero
+static int stepSet(Matcher *mt, int symbol, int *lo, int *hi) {
+    Nfa *a = &mt->re.nfa;
+    int nextLo = INT32_MAX, nextHi = 0;
+    step(a, mt->current + *lo, *lo, *hi, symbol, mt->following, &nextLo, &nextHi);
+    memset(mt->current + *lo, 0, (*hi - *lo) * sizeof(uint64_t));
+    uint64_t *t = mt->current;
+    mt->current = mt->following;
+    mt->following = t;
+    if (nextLo > nextHi)
+        nextLo = nextHi = 0;
+    *lo = nextLo;
+    *hi = nextHi;
+    return mt->current[mt->re.accept >> 6] >> (mt->re.accept & 63) & 1;
+}
+
+int simulateLine(Matcher *mt, const unsigned char *p, const unsigned char *end) {
+    Nfa *a = &mt->re.nfa;
+    int c = a->component[0];
+    int lo = a->closureLo[c], hi = a->closureHi[c];
+    memcpy(mt->current + lo, a->closure[c], (hi - lo) * sizeof(uint64_t));
+    int matched = stepSet(mt, mt->re.lineStart, &lo, &hi);
+    while (p < end && !matched && lo < hi)
+        matched = stepSet(mt, mt->re.byteClass[*p++], &lo, &hi);
+    if (!matched && lo < hi)
+        matched = stepSet(mt, mt->re.lineEnd, &lo, &hi);
+    memset(mt->current + lo, 0, (hi - lo) * sizeof(uint64_t));
+    return matched;
+}
+
+long simulateLines(Matcher *mt, const unsigned char *p, const unsigned char *end, int count) {
+    long matches = 0;
+    while (p < end) {
+        const unsigned char *nl = memchr(p, '\n', end - p);
+        if (simulateLine(mt, p, nl))
+            matches += report(p, nl, count);
+        p = nl + 1;
+    }
+    return matches;
+}
+
+// As simulateLine, with the set of positions in a word. A Shift-And step is
+// done here with the masks by byte rather than by symbol.
+int bitLine(Matcher *mt, const unsigned char *p, const unsigned char *end) {
+    const BitNfa *b = &mt->bits;
+    uint64_t d = bitStep(b, b->start, mt->re.lineStart), final = b->final;
+    if (b->kind == SHIFT) {
+        uint64_t forward = b->forward, loop = b->loop, first = b->first;
+        while (p < end && !(d & final))
+            d = ((d & forward) << 1 | (d & loop) | (-(d & 1) & first)) & mt->byteMask[*p++];
+    } else {
+        while (p < end && !(d & final))
+            d = bitStep(b, d, mt->re.byteClass[*p++]);
+    }
+    if (!(d & final))
+        d = bitStep(b, d, mt->re.lineEnd);
+    return (d & final) != 0;
+}
+
+long bitLines(Matcher *mt, const unsigned char *p, const unsigned char *end, int count) {
+    long matches = 0;
+    while (p < end) {
+        const unsigned char *nl = memchr(p, '\n', end - p);
+        if (bitLine(mt, p, nl))
+            matches += report(p, nl, count);
+        p = nl + 1;
+    }
+    return matches;
+}
+
+long matchLines(Matcher *mt, const unsigned char *p, const unsigned char *end, int count) {
+    if (mt->engine == FULL)
+        return scanLines(mt, p, end, count);
+    if (mt->engine == LAZY)
+        return lazyLines(mt, p, end, count);
+    if (mt->engine == BITS)
+        return bitLines(mt, p, end, count);
+    return simulateLines(mt, p, end, count);
+}
+
+// Only the lines containing the pattern's literal can match, so memmem skips
+// to those and the automaton checks each of them
+long filterLines(Matcher *mt, const unsigned char *p, const unsigned char *end, int count) {
+    const char *literal = mt->re.literal;
+    size_t len = strlen(literal);
+    long matches = 0;
+    while (p < end) {
+        const unsigned char *q = memmem(p, end - p, literal, len);
+        if (!q)
+            break;
+        const unsigned char *from = q, *to = memchr(q, '\n', end - q);
+        while (from > p && from[-1] != '\n')
+            from--;
+        matches += matchLines(mt, from, to + 1, count);
+        p = to + 1;
+    }
+    return matches;
+}
+
+// Match every line of the file, printing the matching ones unless only
+// counting. The complete lines in the buffer are matched after each read and
+// the rest kept for the next; the buffer grows when a line doesn't fit. An
+// unfinished last line is given a newline. Returns the number of matching
+// lines, and the bytes read in *bytes.
+long matchFile(Matcher *mt, int fd, int count, long *bytes) {
+    size_t cap = 1 << 20, len = 0;
+    unsigned char *buf = malloc(cap + 1);
+    long matches = 0;
+    int filter = mt->re.literal[0] != '\0';
+    *bytes = 0;
+    for (;;) {
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap + 1);
+        }
+        ssize_t got = read(fd, buf + len, cap - len);
+        if (got > 0) {
+            len += got;
+            *bytes += got;
+        } else if (len > 0) {
+            buf[len++] = '\n';
+        }
+        size_t done = len;
+        while (done > 0 && buf[done - 1] != '\n')
+            done--;
+        if (filter)
+            matches += filterLines(mt, buf, buf + done, count);
+        else
+            matches += matchLines(mt, buf, buf + done, count);
+        len -= done;
+        memmove(buf, buf + done, len);
+        if (got <= 0)
+            break;
+    }
+    free(buf);
+    return matches;
+}
+
+// Time grep -E -c on the same pattern and file, in the C locale so it
+// works on bytes as this program does
+double timeGrep(const char *pattern, const char *file, long *matches) {
+    int out[2];
+    if (pipe(out) != 0)
+        return -1;
+    double t0 = now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        setenv("LC_ALL", "C", 1);
+        execlp("grep", "grep", "-E", "-c", "--", pattern, file, (char *)NULL);
+        _exit(127);
+    }
+    close(out[1]);
+    char text[64] = "";
+    ssize_t got = read(out[0], text, sizeof(text) - 1);
+    text[got > 0 ? got : 0] = '\0';
+    close(out[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    double t1 = now();
+    if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) > 1)
+        return -1;
+    *matches = atol(text);
+    return t1 - t0;
+}
+
+int main(int argc, char **argv) {
+    int limit = 10000, cache = 4096, engine = FULL, count = 0, bench = 0, opt;
+    while ((opt = getopt(argc, argv, "cnpzs:k:b")) != -1) {
+        switch (opt) {
+        case 'c':
+            count = 1;
+            break;
+        case 'n':
+            engine = SIMULATE;
+            break;
+        case 'p':
+            engine = BITS;
+            break;
+        case 'z':
+            engine = LAZY;
+            break;
+        case 'k':
+            cache = atoi(optarg);
+            break;
+        case 's':
+            limit = atoi(optarg);
+            break;
+        case 'b':
+            bench = count = 1;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc || (bench && optind + 2 != argc)) {
+usage:
+        fprintf(stderr, "usage: %s [-c] [-n | -p | -z] [-s most DFA states] [-k lazy DFA states] [-b] pattern [file]\n", argv[0]);
+        return 2;
+    }
+
+    const char *pattern = argv[optind], *file = optind + 1 < argc ? argv[optind + 1] : NULL;
+    Matcher mt = { 0 };
+    if (!compileRegex(&mt.re, pattern)) {
+        fprintf(stderr, "%s: %s at column %d\n", pattern, mt.re.error, mt.re.errorAt + 1);
+        return 2;
+    }
+    double t0 = now();
+    int states = buildMatcher(&mt, engine, limit, cache);
+    double t1 = now();
+
+    int fd = file ? open(file, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(file);
+        return 2;
+    }
+    static char out[1 << 16];
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    long bytes;
+    long matches = matchFile(&mt, fd, count, &bytes);
+    double t2 = now();
+    if (count && !bench)
+        printf("%ld\n", matches);
+
+    if (bench) {
+        long grepMatches = 0;
+        double grepMs = timeGrep(pattern, file, &grepMatches);
+        printf("%s: %d NFA states, ", pattern, mt.re.nfa.n);
+        if (mt.re.literal[0])
+            printf("literal \"%s\", ", mt.re.literal);
+        if (mt.engine == FULL)
+            printf("%d DFA states in %.1f ms\n", states, t1 - t0);
+        else if (mt.engine == LAZY)
+            printf("lazy DFA of at most %d states\n", mt.cache);
+        else if (mt.engine == BITS)
+            printf("simulating %d positions in a word, %s\n", states,
+                   mt.bits.kind == SHIFT ? "Shift-And" : mt.bits.kind == GLUSHKOV ? "Glushkov" : "by symbol");
+        else
+            printf("simulating the NFA\n");
+        printf("  this:    %9ld lines  %8.1f ms  %8.1f MB/s\n", matches, t2 - t1,
+               bytes / 1048576.0 / ((t2 - t1) / 1e3));
+        if (mt.engine == LAZY)
+            printf("  cache:   %.4f%% of %ld steps hit, %ld misses, %ld flushes\n",
+                   mt.steps ? 100.0 * (mt.steps - mt.misses) / mt.steps : 100.0, mt.steps,
+                   mt.misses, mt.flushes);
+        if (grepMs < 0)
+            printf("  grep -E: failed\n");
+        else
+            printf("  grep -E: %9ld lines  %8.1f ms  %8.1f MB/s\n", grepMatches, grepMs,
+                   bytes / 1048576.0 / (grepMs / 1e3));
+    }
+    return matches > 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bitnfa.h"
+
+// Runs an NFA on strings, read after it one per word, and says whether it
+// accepts each. NFAs of at most 64 positions are simulated on a word of
+// their positions, the others on bitsets of their states; -b times both on
+// random input and checks that they agree.
+double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+unsigned long long seed = 88172645463325252ULL;
+
+int randomInt(int n) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return (int)(seed % n);
+}
+
+// Two moves from each state on random symbols to random states, now and
+// then an epsilon move, and an eighth of the states accepting
+void generateNfa(Nfa *a, int n, int m) {
+    initNfa(a, n, m, "abcdefghijklmnopqrstuvwxyz");
+    for (int i = 0; i < n; i++) {
+        addMove(a, i, randomInt(m), randomInt(n));
+        addMove(a, i, randomInt(m), randomInt(n));
+        if (randomInt(4) == 0)
+            addMove(a, i, -1, randomInt(n));
+        a->final[i] = randomInt(8) == 0;
+    }
+    compressNfa(a);
+}
+
+// The set simulation keeps the words lo to hi - 1 of its set nonzero, and
+// swaps it with the scratch set after each step
+typedef struct {
+    uint64_t *set, *scratch;
+    int lo, hi;
+} Sets;
+
+static void restart(Nfa *a, Sets *s) {
+    int c = a->component[0];
+    memset(s->set + s->lo, 0, (s->hi - s->lo) * sizeof(uint64_t));
+    s->lo = a->closureLo[c];
+    s->hi = a->closureHi[c];
+    memcpy(s->set + s->lo, a->closure[c], (s->hi - s->lo) * sizeof(uint64_t));
+}
+
+static void stepSets(Nfa *a, Sets *s, int symbol) {
+    int lo = INT32_MAX, hi = 0;
+    step(a, s->set + s->lo, s->lo, s->hi, symbol, s->scratch, &lo, &hi);
+    memset(s->set + s->lo, 0, (s->hi - s->lo) * sizeof(uint64_t));
+    uint64_t *t = s->set;
+    s->set = s->scratch;
+    s->scratch = t;
+    if (lo > hi)
+        lo = hi = 0;
+    s->lo = lo;
+    s->hi = hi;
+}
+
+static int acceptsSets(Nfa *a, Sets *s) {
+    for (int w = s->lo; w < s->hi; w++)
+        for (uint64_t bits = s->set[w]; bits; bits &= bits - 1)
+            if (a->final[w << 6 | __builtin_ctzll(bits)])
+                return 1;
+    return 0;
+}
+
+// Step both simulations through the same random symbols, starting over when
+// the set dies, and count the steps after which each accepts
+void benchmark(Nfa *a, BitNfa *b, Sets *s, long steps) {
+    unsigned char *input = malloc(steps + 1);
+    for (long i = 0; i < steps; i++)
+        input[i] = randomInt(a->m);
+
+    double t0 = now();
+    long setAccepts = 0;
+    restart(a, s);
+    for (long i = 0; i < steps; i++) {
+        stepSets(a, s, input[i]);
+        if (s->lo == s->hi)
+            restart(a, s);
+        setAccepts += acceptsSets(a, s);
+    }
+    double t1 = now();
+    long bitAccepts = 0;
+    uint64_t d = b->start;
+    for (long i = 0; i < steps; i++) {
+        d = bitStep(b, d, input[i]);
+        if (!d)
+            d = b->start;
+        bitAccepts += (d & b->final) != 0;
+    }
+    double t2 = now();
+
+    printf("%d states, %d positions, %s\n", a->n, b->n,
+           b->kind == SHIFT ? "Shift-And" : b->kind == GLUSHKOV ? "Glushkov" : "by symbol");
+    printf("  sets:  %8.2f ns per symbol, accepting after %ld\n", (t1 - t0) * 1e6 / steps, setAccepts);
+    printf("  word:  %8.2f ns per symbol, accepting after %ld%s\n", (t2 - t1) * 1e6 / steps, bitAccepts,
+           bitAccepts == setAccepts ? "" : "  MISMATCH");
+    free(input);
+}
+
+int main(int argc, char **argv) {
+    int generate = 0, symbols = 2, bench = 0, opt;
+    const char *path = NULL, *output = NULL;
+    while ((opt = getopt(argc, argv, "g:m:f:w:b")) != -1) {
+        switch (opt) {
+        case 'g':
+            generate = atoi(optarg);
+            break;
+        case 'm':
+            symbols = atoi(optarg);
+            break;
+        case 'f':
+            path = optarg;
+            break;
+        case 'w':
+            output = optarg;
+            break;
+        case 'b':
+            bench = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-g states [-m symbols] | -f file] [-w file] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Nfa a;
+    if (generate > 0) {
+        generateNfa(&a, generate, symbols < 1 ? 1 : symbols > 26 ? 26 : symbols);
+    } else if (path) {
+        if (!loadNfa(&a, path))
+            return 1;
+    } else {
+        if (!readNfa(&a, stdin))
+            return 1;
+        readFinalStates(&a, stdin);
+    }
+    if (output && !saveNfa(&a, output))
+        return 1;
+    computeEpsilonClosures(&a);
+    Sets s = { calloc((a.n + 63) / 64 + 1, sizeof(uint64_t)),
+               calloc((a.n + 63) / 64 + 1, sizeof(uint64_t)), 0, 0 };
+    BitNfa b;
+    int bits = buildBitNfa(&b, &a);
+
+    if (bench) {
+        if (!bits) {
+            fprintf(stderr, "more than 64 positions\n");
+            return 2;
+        }
+        benchmark(&a, &b, &s, 10000000);
+        return 0;
+    }
+
+    if (isatty(fileno(stdin)))
+        printf("Enter strings to run:\n");
+    char word[4096];
+    while (scanf("%4095s", word) == 1) {
+        uint64_t d = b.start;
+        int known = 1;
+        restart(&a, &s);
+        for (char *c = word; *c && known; c++) {
+            const char *j = memchr(a.symbols, *c, a.m);
+            if (!j)
+                known = 0;
+            else if (bits)
+                d = bitStep(&b, d, j - a.symbols);
+            else
+                stepSets(&a, &s, j - a.symbols);
+        }
+        int accepted = known && (bits ? (d & b.final) != 0 : acceptsSets(&a, &s));
+        printf("%s: %s\n", word, accepted ? "accepted" : "rejected");
+    }
+    return 0;
+}
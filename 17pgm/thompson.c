@@ -0,0 +1,525 @@
+#include <string.h>
+#include <ctype.h>
+#include "thompson.h"
+
+// The expression is parsed into a tree first, so the byte classes are known
+// before any move is added and {m,n} can build its operand more than once
+typedef struct {
+    char type;                  // c set, ^ $, e empty, & concatenation, | or, * + ? r{m,n}
+    int left, right;            // operands, right only for & and |
+    int set;                    // for c: index into sets
+    int min, max;               // for r: max -1 for no limit
+} Node;
+
+typedef struct {
+    const char *pattern, *p;
+    Node *nodes;
+    int nodeCount, nodeCap;
+    uint64_t (*sets)[4];
+    int setCount, setCap;
+    int depth;
+    Regex *r;
+} Parser;
+
+typedef struct {
+    int start, end;
+} Frag;
+
+typedef struct {
+    Regex *r;
+    Parser *parser;
+    int states, add;            // moves are only added on the second pass
+    int *setSymbols;            // for each class, the byte standing for it
+} Builder;
+
+static int fail(Parser *ps, const char *message) {
+    if (!ps->r->error) {
+        ps->r->error = message;
+        ps->r->errorAt = (int)(ps->p - ps->pattern);
+    }
+    return -1;
+}
+
+static int newNode(Parser *ps, char type, int left, int right) {
+    if (ps->nodeCount == ps->nodeCap) {
+        ps->nodeCap = ps->nodeCap ? 2 * ps->nodeCap : 64;
+        ps->nodes = realloc(ps->nodes, ps->nodeCap * sizeof(Node));
+    }
+    Node *x = &ps->nodes[ps->nodeCount];
+    x->type = type;
+    x->left = left;
+    x->right = right;
+    x->set = -1;
+    x->min = x->max = 0;
+    return ps->nodeCount++;
+}
+
+static uint64_t *newSet(Parser *ps) {
+    if (ps->setCount == ps->setCap) {
+        ps->setCap = ps->setCap ? 2 * ps->setCap : 64;
+        ps->sets = realloc(ps->sets, ps->setCap * sizeof(*ps->sets));
+    }
+    memset(ps->sets[ps->setCount], 0, sizeof(*ps->sets));
+    return ps->sets[ps->setCount++];
+}
+
+static void addByte(uint64_t *set, int c) {
+    set[c >> 6] |= 1ULL << (c & 63);
+}
+
+static void addRange(uint64_t *set, int from, int to) {
+    for (int c = from; c <= to; c++)
+        addByte(set, c);
+}
+
+static void addClass(uint64_t *set, int (*is)(int), int negate) {
+    for (int c = 0; c < 256; c++)
+        if (!is(c) != !negate)
+            addByte(set, c);
+}
+
+static int isWord(int c) {
+    return isalnum(c) || c == '_';
+}
+
+// The set for an escape, or 0 if the escaped character stands for itself
+static int escapeSet(uint64_t *set, int c) {
+    switch (c) {
+    case 'n': addByte(set, '\n'); return 1;
+    case 't': addByte(set, '\t'); return 1;
+    case 'd': addClass(set, isdigit, 0); return 1;
+    case 'D': addClass(set, isdigit, 1); return 1;
+    case 'w': addClass(set, isWord, 0); return 1;
+    case 'W': addClass(set, isWord, 1); return 1;
+    case 's': addClass(set, isspace, 0); return 1;
+    case 'S': addClass(set, isspace, 1); return 1;
+    }
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    int (*is)(int);
+} namedClasses[] = {
+    { "alpha", isalpha }, { "digit", isdigit }, { "alnum", isalnum },
+    { "upper", isupper }, { "lower", islower }, { "space", isspace },
+    { "punct", ispunct }, { "xdigit", isxdigit }, { "print", isprint },
+    { "graph", isgraph }, { "cntrl", iscntrl }, { "blank", isblank },
+};
+
+// [...] after the [, up to and including the ]
+static int parseSet(Parser *ps) {
+    int node = newNode(ps, 'c', -1, -1);
+    ps->nodes[node].set = ps->setCount;
+    uint64_t *set = newSet(ps);
+    int negate = *ps->p == '^';
+    if (negate)
+        ps->p++;
+    for (int first = 1; first || *ps->p != ']'; first = 0) {
+        if (*ps->p == '\0')
+            return fail(ps, "missing ]");
+        if (ps->p[0] == '[' && ps->p[1] == ':') {
+            const char *end = strstr(ps->p + 2, ":]");
+            int k, count = sizeof(namedClasses) / sizeof(namedClasses[0]);
+            for (k = 0; end && k < count; k++)
+                if ((int)strlen(namedClasses[k].name) == end - ps->p - 2
+                    && strncmp(namedClasses[k].name, ps->p + 2, end - ps->p - 2) == 0)
+                    break;
+            if (!end || k == count)
+                return fail(ps, "unknown character class");
+            addClass(set, namedClasses[k].is, 0);
+            ps->p = end + 2;
+            continue;
+        }
+        int from = (unsigned char)*ps->p++;
+        if (ps->p[0] == '-' && ps->p[1] != ']' && ps->p[1] != '\0') {
+            int to = (unsigned char)ps->p[1];
+            if (to < from)
+                return fail(ps, "range out of order");
+            addRange(set, from, to);
+            ps->p += 2;
+        } else {
+            addByte(set, from);
+        }
+    }
+    ps->p++;
+    if (negate) {
+        for (int w = 0; w < 4; w++)
+            set[w] = ~set[w];
+        set['\n' >> 6] &= ~(1ULL << ('\n' & 63));
+    }
+    return node;
+}
+
+static int parseAlt(Parser *ps);
+
+static int parseAtom(Parser *ps) {
+    int c = (unsigned char)*ps->p;
+    if (c == '(') {
+        ps->p++;
+        ps->depth++;
+        int x = parseAlt(ps);
+        if (x < 0)
+            return x;
+        if (*ps->p != ')')
+            return fail(ps, "missing )");
+        ps->p++;
+        ps->depth--;
+        return x;
+    }
+    if (c == '[') {
+        ps->p++;
+        return parseSet(ps);
+    }
+    if (c == '*' || c == '+' || c == '?')
+        return fail(ps, "nothing to repeat");
+    if (c == '^' || c == '$') {
+        while (*ps->p == c)     // each is read once, and ^^ means ^
+            ps->p++;
+        return newNode(ps, c, -1, -1);
+    }
+
+    int node = newNode(ps, 'c', -1, -1);
+    ps->nodes[node].set = ps->setCount;
+    uint64_t *set = newSet(ps);
+    ps->p++;
+    if (c == '.') {
+        addRange(set, 0, 255);
+        set['\n' >> 6] &= ~(1ULL << ('\n' & 63));
+    } else if (c == '\\') {
+        c = (unsigned char)*ps->p;
+        if (c == '\0')
+            return fail(ps, "trailing \\");
+        ps->p++;
+        if (!escapeSet(set, c))
+            addByte(set, c);
+    } else {
+        addByte(set, c);
+    }
+    return node;
+}
+
+// {m}, {m,} or {m,n}; anything else starting with { is an ordinary character
+static int parseBounds(Parser *ps, int *min, int *max) {
+    const char *q = ps->p + 1;
+    if (!isdigit((unsigned char)*q))
+        return 0;
+    *min = (int)strtol(q, (char **)&q, 10);
+    *max = *min;
+    if (*q == ',') {
+        q++;
+        *max = isdigit((unsigned char)*q) ? (int)strtol(q, (char **)&q, 10) : -1;
+    }
+    if (*q != '}')
+        return 0;
+    ps->p = q + 1;
+    return 1;
+}
+
+static int parseRepeat(Parser *ps) {
+    int x = parseAtom(ps);
+    while (x >= 0) {
+        int c = *ps->p, min, max;
+        if (c == '*' || c == '+' || c == '?') {
+            ps->p++;
+            x = newNode(ps, c, x, -1);
+        } else if (c == '{' && parseBounds(ps, &min, &max)) {
+            if (max >= 0 && max < min)
+                return fail(ps, "bad repetition bounds");
+            if (min > 1000 || max > 1000)
+                return fail(ps, "repetition over 1000");
+            x = newNode(ps, 'r', x, -1);
+            ps->nodes[x].min = min;
+            ps->nodes[x].max = max;
+        } else {
+            break;
+        }
+    }
+    return x;
+}
+
+static int atEnd(Parser *ps) {
+    return *ps->p == '\0' || *ps->p == '|' || (*ps->p == ')' && ps->depth > 0);
+}
+
+static int parseCat(Parser *ps) {
+    if (atEnd(ps))
+        return newNode(ps, 'e', -1, -1);
+    int x = -1;
+    while (!atEnd(ps)) {
+        if (*ps->p == ')')
+            return fail(ps, "unmatched )");
+        int y = parseRepeat(ps);
+        if (y < 0)
+            return y;
+        x = x < 0 ? y : newNode(ps, '&', x, y);
+    }
+    return x;
+}
+
+static int parseAlt(Parser *ps) {
+    int x = parseCat(ps);
+    while (x >= 0 && *ps->p == '|') {
+        ps->p++;
+        int y = parseCat(ps);
+        if (y < 0)
+            return y;
+        x = newNode(ps, '|', x, y);
+    }
+    return x;
+}
+
+static int newState(Builder *b) {
+    return b->states++;
+}
+
+static void move(Builder *b, int from, int symbol, int to) {
+    if (b->add)
+        addMove(&b->r->nfa, from, symbol, to);
+}
+
+static Frag build(Builder *b, int node) {
+    Node *x = &b->parser->nodes[node];
+    Frag f, g;
+    switch (x->type) {
+    case 'c': {
+        uint64_t *set = b->parser->sets[x->set];
+        f.start = newState(b);
+        f.end = newState(b);
+        for (int j = 0; b->add && j < b->r->nfa.m; j++) {
+            int c = b->setSymbols[j];
+            if (c >= 0 && set[c >> 6] >> (c & 63) & 1)
+                move(b, f.start, j, f.end);
+        }
+        return f;
+    }
+    case '^':
+    case '$':
+        f.start = newState(b);
+        f.end = newState(b);
+        move(b, f.start, x->type == '^' ? b->r->lineStart : b->r->lineEnd, f.end);
+        return f;
+    case '&':
+        f = build(b, x->left);
+        g = build(b, x->right);
+        move(b, f.end, -1, g.start);
+        f.end = g.end;
+        return f;
+    case '|': {
+        Frag l = build(b, x->left), r = build(b, x->right);
+        f.start = newState(b);
+        f.end = newState(b);
+        move(b, f.start, -1, l.start);
+        move(b, f.start, -1, r.start);
+        move(b, l.end, -1, f.end);
+        move(b, r.end, -1, f.end);
+        return f;
+    }
+    case '*':
+    case '?':
+        g = build(b, x->left);
+        f.start = newState(b);
+        f.end = newState(b);
+        move(b, f.start, -1, g.start);
+        move(b, f.start, -1, f.end);
+        move(b, g.end, -1, f.end);
+        if (x->type == '*')
+            move(b, g.end, -1, g.start);
+        return f;
+    case '+':
+        f = build(b, x->left);
+        g.end = newState(b);
+        move(b, f.end, -1, f.start);
+        move(b, f.end, -1, g.end);
+        f.end = g.end;
+        return f;
+    case 'r': {
+        // x{m,n} is m copies of x followed by n - m copies of x?, or by x*
+        // if there is no n
+        int copies = x->max < 0 ? x->min + 1 : x->max, min = x->min, max = x->max;
+        f.start = f.end = newState(b);
+        for (int k = 0; k < copies; k++) {
+            g = build(b, b->parser->nodes[node].left);
+            move(b, f.end, -1, g.start);
+            if (k >= min) {
+                move(b, f.end, -1, g.end);
+                if (max < 0)
+                    move(b, g.end, -1, g.start);
+            }
+            f.end = g.end;
+        }
+        return f;
+    }
+    default:
+        f.start = newState(b);
+        f.end = newState(b);
+        move(b, f.start, -1, f.end);
+        return f;
+    }
+}
+
+// What is known of the strings a subexpression matches: whether they are
+// all one string, exact, and strings they all start with, end with and
+// contain
+typedef struct {
+    int isExact;
+    char *exact, *prefix, *suffix, *must;
+} Facts;
+
+static char *join(const char *a, const char *b) {
+    size_t la = strlen(a), lb = strlen(b);
+    char *s = malloc(la + lb + 1);
+    memcpy(s, a, la);
+    memcpy(s + la, b, lb + 1);
+    return s;
+}
+
+static void freeFacts(Facts *f) {
+    free(f->exact);
+    free(f->prefix);
+    free(f->suffix);
+    free(f->must);
+}
+
+static char *longest(char *a, char *b) {
+    if (strlen(b) > strlen(a)) {
+        free(a);
+        return b;
+    }
+    free(b);
+    return a;
+}
+
+static Facts facts(Parser *ps, int node) {
+    Node *x = &ps->nodes[node];
+    Facts f = { 0, strdup(""), strdup(""), strdup(""), strdup("") }, l, r;
+    int c = -1;
+    switch (x->type) {
+    case 'c':
+        for (int k = 0; k < 256; k++) {
+            if (ps->sets[x->set][k >> 6] >> (k & 63) & 1) {
+                if (c >= 0)
+                    return f;
+                c = k;
+            }
+        }
+        if (c <= 0 || c == '\n')
+            return f;
+        free(f.exact);
+        f.exact = malloc(2);
+        f.exact[0] = (char)c;
+        f.exact[1] = '\0';
+        // fall through
+    case 'e':
+    case '^':
+    case '$':
+        f.isExact = 1;
+        free(f.prefix);
+        free(f.suffix);
+        free(f.must);
+        f.prefix = strdup(f.exact);
+        f.suffix = strdup(f.exact);
+        f.must = strdup(f.exact);
+        return f;
+    case '&':
+        l = facts(ps, x->left);
+        r = facts(ps, x->right);
+        freeFacts(&f);
+        f.isExact = l.isExact && r.isExact;
+        f.exact = f.isExact ? join(l.exact, r.exact) : strdup("");
+        f.prefix = l.isExact ? join(l.exact, r.prefix) : strdup(l.prefix);
+        f.suffix = r.isExact ? join(l.suffix, r.exact) : strdup(r.suffix);
+        f.must = longest(join(l.suffix, r.prefix), longest(strdup(l.must), strdup(r.must)));
+        f.must = longest(f.must, longest(strdup(f.prefix), strdup(f.suffix)));
+        freeFacts(&l);
+        freeFacts(&r);
+        return f;
+    case '+':
+    case 'r':
+        if (x->type == 'r' && x->min == 0)
+            return f;
+        freeFacts(&f);
+        l = facts(ps, x->left);
+        f.isExact = 0;
+        f.exact = strdup("");
+        f.prefix = strdup(l.prefix);
+        f.suffix = strdup(l.suffix);
+        f.must = strdup(l.must);
+        freeFacts(&l);
+        return f;
+    }
+    return f;
+}
+
+// Parse the pattern, split the bytes into classes by the sets that use them
+// and build the NFA, counting its states on a first pass. Returns 0 and sets
+// error if the pattern doesn't parse.
+int compileRegex(Regex *r, const char *pattern) {
+    Parser ps = { 0 };
+    memset(r, 0, sizeof(*r));
+    ps.pattern = ps.p = pattern;
+    ps.r = r;
+
+    int root = parseAlt(&ps);
+    if (root >= 0 && *ps.p != '\0')
+        root = fail(&ps, "unmatched )");
+    if (root < 0) {
+        free(ps.nodes);
+        free(ps.sets);
+        return 0;
+    }
+
+    Facts f = facts(&ps, root);
+    r->literal = f.must;
+    f.must = NULL;
+    freeFacts(&f);
+
+    // Refine one class of all bytes by each set in turn
+    int classOf[256], count = 1;
+    for (int c = 0; c < 256; c++)
+        classOf[c] = 0;
+    int *split = malloc(2 * 256 * sizeof(int));
+    for (int s = 0; s < ps.setCount; s++) {
+        int next = 0;
+        for (int k = 0; k < 2 * count; k++)
+            split[k] = -1;
+        for (int c = 0; c < 256; c++) {
+            int k = 2 * classOf[c] + (int)(ps.sets[s][c >> 6] >> (c & 63) & 1);
+            if (split[k] < 0)
+                split[k] = next++;
+            classOf[c] = split[k];
+        }
+        count = next;
+    }
+    free(split);
+
+    char symbols[258];
+    int setSymbols[258];
+    for (int c = 255; c >= 0; c--) {
+        r->byteClass[c] = (unsigned char)classOf[c];
+        symbols[classOf[c]] = (char)c;
+        setSymbols[classOf[c]] = c;
+    }
+    r->lineStart = count;
+    r->lineEnd = count + 1;
+    symbols[count] = '^';
+    symbols[count + 1] = '$';
+    setSymbols[count] = setSymbols[count + 1] = -1;
+
+    Builder b = { r, &ps, 1, 0, setSymbols };
+    build(&b, root);
+    initNfa(&r->nfa, b.states, count + 2, symbols);
+    b.states = 1;
+    b.add = 1;
+    Frag g = build(&b, root);
+    for (int j = 0; j < count + 2; j++)
+        move(&b, 0, j, 0);
+    move(&b, 0, -1, g.start);
+    r->accept = g.end;
+    r->nfa.final[g.end] = 1;
+    compressNfa(&r->nfa);
+
+    free(ps.nodes);
+    free(ps.sets);
+    return 1;
+}
@@ -0,0 +1,28 @@
+#ifndef THOMPSON_H
+#define THOMPSON_H
+
+#include "nfa.h"
+
+// A regular expression compiled into a Thompson NFA. The NFA's symbols are
+// classes of bytes that no character set in the expression tells apart, so
+// byteClass maps each byte to its symbol, and two more symbols, lineStart
+// and lineEnd, which the matcher reads before and after each line: ^ and $
+// are moves on them. The NFA starts in q0, which loops on every symbol so
+// that the expression is found anywhere, and has one accepting state.
+//
+// The syntax is that of egrep: literals, ., [sets] with ranges, ^ and
+// [:classes:], escapes \n \t \d \w \s and \ before any other character,
+// grouping, |, * + ? and {m}, {m,}, {m,n}, ^ and $.
+typedef struct {
+    Nfa nfa;
+    unsigned char byteClass[256];
+    int lineStart, lineEnd;
+    int accept;
+    char *literal;              // a string every matching line contains, maybe ""
+    const char *error;          // what went wrong, NULL if it compiled
+    int errorAt;                // where in the pattern
+} Regex;
+
+int compileRegex(Regex *r, const char *pattern);
+
+#endif